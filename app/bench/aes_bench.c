@@ -0,0 +1,306 @@
+/*
+ * Copyright (c) 2015, Linaro Limited
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * aes_bench: cycles per byte of the TA's AES backends, for a range of chunk
+ * sizes. The backends that do not need the TEE Internal API are built
+ * natively from the TA sources, so this runs on the build machine or in the
+ * normal world of the board. Cycles come from perf_event_open(); when the
+ * counter is not available, nanoseconds per byte are reported instead.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <err.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#include "aes_backend.h"
+
+#define BUF_SIZE	(2 * 1024 * 1024)
+
+#define FP(args...) do { fprintf(stderr, args); } while(0)
+
+static const struct aes_backend *const backends[] = {
+	&aes_backend_ce,
+	&aes_backend_soft,
+};
+
+/* 2048 is the chunk the TA decrypts at a time when scaling */
+static const size_t chunk_sizes[] = {
+	16, 64, 256, 1024, 2048, 4096, 16384, 65536, 262144, 1048576
+};
+
+static const uint8_t aes_key[] =
+	{ 0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07,
+	  0x08, 0x09, 0x0A, 0x0B, 0x0C, 0x0D, 0x0E, 0x0F };
+
+static uint8_t *in, *out, *ref;
+static size_t total = 8 * 1024 * 1024;	/* Bytes per measurement */
+static int repeats = 5;
+static int perf_fd = -1;
+
+static void usage(void)
+{
+	FP("Usage: aes_bench [-b <backend>] [-s <bytes>] [-r <repeats>]\n");
+	FP("       aes_bench -h\n");
+	FP(" -b       Only run this backend (ce or soft).\n");
+	FP(" -s       Bytes processed per measurement [%zu].\n", total);
+	FP(" -r       Measurements per point, the best one is kept [%d].\n",
+	   repeats);
+	FP(" -h       This help.\n");
+}
+
+static void counter_open(void)
+{
+	struct perf_event_attr attr;
+
+	memset(&attr, 0, sizeof(attr));
+	attr.type = PERF_TYPE_HARDWARE;
+	attr.size = sizeof(attr);
+	attr.config = PERF_COUNT_HW_CPU_CYCLES;
+	attr.exclude_kernel = 1;
+	attr.exclude_hv = 1;
+	perf_fd = syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+	if (perf_fd < 0)
+		warn("perf_event_open, falling back to ns/byte");
+}
+
+/* CPU cycles, or nanoseconds without a cycle counter */
+static uint64_t counter(void)
+{
+	struct timespec ts;
+	uint64_t v;
+
+	if (perf_fd >= 0 && read(perf_fd, &v, sizeof(v)) == sizeof(v))
+		return v;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static int hex(const char *s, uint8_t *b, size_t n)
+{
+	unsigned int v;
+	size_t i;
+
+	for (i = 0; i < n; i++) {
+		if (sscanf(s + 2 * i, "%2x", &v) != 1)
+			return -1;
+		b[i] = v;
+	}
+	return 0;
+}
+
+/* SP 800-38A F.1.2, ECB-AES128.Decrypt */
+static const char *const ecb_ct[] = {
+	"3ad77bb40d7a3660a89ecaf32466ef97", "f5d3d58503b9699de785895a96fdbaaf",
+	"43b1cd7f598ece23881b00e3ed030688", "7b0c785e27e8ad3f8223207104725dd4",
+};
+static const char *const ecb_pt[] = {
+	"6bc1bee22e409f96e93d7e117393172a", "ae2d8a571e03ac9c9eb76fac45af8e51",
+	"30c81c46a35ce411e5fbc1191a0a52ef", "f69f2445df4f9b17ad2b417be66c3710",
+};
+
+/*
+ * Same output as the soft backend for every block count up to 9, and CTR
+ * lengths that end anywhere in a block, so that the tails of interleaved
+ * loops are covered.
+ */
+static int cross_check(const struct aes_backend *b, const uint8_t *key)
+{
+	const struct aes_backend *s = &aes_backend_soft;
+	uint8_t ctr[16], ctr2[16];
+	size_t n;
+
+	if (b == s)
+		return 0;
+	if (s->set_key(key))
+		return -1;
+	for (n = 16; n <= 9 * 16; n += 16) {
+		if (b->ecb_decrypt(in, out, n) || s->ecb_decrypt(in, ref, n) ||
+		    memcmp(out, ref, n))
+			return -1;
+	}
+	for (n = 1; n <= 9 * 16 + 1; n += 3) {
+		memset(ctr, 0xfe, sizeof(ctr));
+		memcpy(ctr2, ctr, sizeof(ctr));
+		if (b->ctr_crypt(ctr, in, out, n) ||
+		    s->ctr_crypt(ctr2, in, ref, n) ||
+		    memcmp(out, ref, n) || memcmp(ctr, ctr2, sizeof(ctr)))
+			return -1;
+	}
+	return 0;
+}
+
+/*
+ * Known answers from FIPS-197 (ECB, one block), SP 800-38A (ECB, four
+ * blocks then five with the first one repeated, and CTR), comparison with
+ * the soft backend, then a long CTR run in uneven chunks against the same
+ * data in one call.
+ */
+static int self_test(const struct aes_backend *b)
+{
+	uint8_t key[16], ctr[16], ctr2[16], a[16 * 5], c[16 * 5], p[16 * 5];
+	size_t off, n;
+
+	hex("000102030405060708090a0b0c0d0e0f", key, 16);
+	hex("69c4e0d86a7b0430d8cdb78070b4c55a", c, 16);
+	hex("00112233445566778899aabbccddeeff", p, 16);
+	if (b->set_key(key) || b->ecb_decrypt(c, a, 16) || memcmp(a, p, 16))
+		return -1;
+
+	hex("2b7e151628aed2a6abf7158809cf4f3c", key, 16);
+	for (n = 0; n < 5; n++) {
+		hex(ecb_ct[n % 4], c + 16 * n, 16);
+		hex(ecb_pt[n % 4], p + 16 * n, 16);
+	}
+	if (b->set_key(key) || b->ecb_decrypt(c, a, 16 * 4) ||
+	    memcmp(a, p, 16 * 4) || b->ecb_decrypt(c, a, 16 * 5) ||
+	    memcmp(a, p, 16 * 5))
+		return -1;
+
+	hex("f0f1f2f3f4f5f6f7f8f9fafbfcfdfeff", ctr, 16);
+	hex("874d6191b620e3261bef6864990db6ce", c, 16);
+	if (b->ctr_crypt(ctr, p, a, 16) || memcmp(a, c, 16))
+		return -1;
+
+	if (cross_check(b, key))
+		return -1;
+
+	memset(ctr, 0xff, sizeof(ctr));
+	memcpy(ctr2, ctr, sizeof(ctr));
+	if (b->ctr_crypt(ctr, in, ref, 100000))
+		return -1;
+	for (off = 0; off < 100000; off += n) {
+		n = (off / 16 % 7 + 1) * 16;
+		if (n > 100000 - off)
+			n = 100000 - off;
+		if (b->ctr_crypt(ctr2, in + off, out + off, n))
+			return -1;
+	}
+	if (memcmp(ref, out, 100000) || memcmp(ctr, ctr2, sizeof(ctr)))
+		return -1;
+
+	return b->set_key(aes_key);
+}
+
+/* Best of the repeats, in counter units per byte */
+static double measure(const struct aes_backend *b, int ctr_mode,
+		      size_t chunk)
+{
+	uint8_t iv[16] = { 0 };
+	size_t i, iters, off = 0;
+	uint64_t t;
+	double v, best = 0;
+	int r;
+
+	iters = total / chunk ? total / chunk : 1;
+	for (r = 0; r < repeats; r++) {
+		t = counter();
+		for (i = 0; i < iters; i++) {
+			if (ctr_mode)
+				b->ctr_crypt(iv, in + off, out + off, chunk);
+			else
+				b->ecb_decrypt(in + off, out + off, chunk);
+			off += chunk;
+			if (off + chunk > BUF_SIZE)
+				off = 0;
+		}
+		v = (double)(counter() - t) / (iters * chunk);
+		if (!r || v < best)
+			best = v;
+	}
+	return best;
+}
+
+int main(int argc, char *argv[])
+{
+	const char *only = NULL;
+	const struct aes_backend *b;
+	size_t n, k;
+	int i;
+
+	for (i = 1; i < argc && argv[i][0] == '-'; i++) {
+		if (!strcmp(argv[i], "-h")) {
+			usage();
+			return 0;
+		} else if (i + 1 >= argc) {
+			usage();
+			return 1;
+		} else if (!strcmp(argv[i], "-b")) {
+			only = argv[++i];
+		} else if (!strcmp(argv[i], "-s")) {
+			total = strtoul(argv[++i], NULL, 0);
+		} else if (!strcmp(argv[i], "-r")) {
+			repeats = strtol(argv[++i], NULL, 0);
+		} else {
+			usage();
+			return 1;
+		}
+	}
+	if (i != argc || !total || repeats < 1) {
+		usage();
+		return 1;
+	}
+
+	in = malloc(BUF_SIZE);
+	out = malloc(BUF_SIZE);
+	ref = malloc(BUF_SIZE);
+	if (!in || !out || !ref)
+		err(1, "malloc");
+	srand(1);
+	for (n = 0; n < BUF_SIZE; n++)
+		in[n] = rand();
+
+	counter_open();
+
+	for (n = 0; n < sizeof(backends) / sizeof(backends[0]); n++) {
+		b = backends[n];
+		if (only && strcmp(only, b->name))
+			continue;
+		if (!b->probe()) {
+			printf("%s: not available in this build\n", b->name);
+			continue;
+		}
+		if (self_test(b))
+			errx(1, "%s: self test failed", b->name);
+
+		printf("%s: %s per byte\n", b->name,
+		       perf_fd >= 0 ? "cycles" : "ns");
+		printf("%10s %10s %10s\n", "chunk", "ecb", "ctr");
+		for (k = 0; k < sizeof(chunk_sizes) / sizeof(chunk_sizes[0]);
+		     k++)
+			printf("%10zu %10.2f %10.2f\n", chunk_sizes[k],
+			       measure(b, 0, chunk_sizes[k]),
+			       measure(b, 1, chunk_sizes[k]));
+		b->release();
+	}
+
+	return 0;
+}
@@ -0,0 +1,184 @@
+/*
+ * Copyright (c) 2015, Linaro Limited
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "chunk_tuner.h"
+
+#define MAX_SHIFT	30
+/* A measurement lasts at least this many invokes and bytes */
+#define SAMPLE_INVOKES	4
+#define SAMPLE_BYTES	(2 * 1024 * 1024)
+/* Once converged, probe again after this many bytes... */
+#define RECHECK_BYTES	(256 * 1024 * 1024)
+/* ...or as soon as throughput falls below this fraction of the best one */
+#define DRIFT		0.8
+/* A neighbour must be this much faster to be preferred */
+#define HYSTERESIS	1.02
+
+#define PR(args...) do { printf(args); fflush(stdout); } while (0)
+
+static struct {
+	int min, max;		/* Range of size shifts */
+	int cur;		/* Best size so far */
+	int trial;		/* Size being measured */
+	int stable;		/* Converged on cur */
+	int measured[MAX_SHIFT + 1];
+	double tput[MAX_SHIFT + 1];	/* Bytes per second */
+	double best_tput;	/* Throughput of cur when converged */
+	size_t since_check;
+	/* Current measurement */
+	size_t bytes;
+	double secs;
+	unsigned int invokes;
+} t;
+
+static int shift_of(size_t size)
+{
+	int s = 0;
+
+	while (s < MAX_SHIFT && ((size_t)1 << (s + 1)) <= size)
+		s++;
+	return s;
+}
+
+/* Returns the next size to measure, or -1 when cur is a local optimum */
+static int next_trial(void)
+{
+	int best;
+
+	for (;;) {
+		if (!t.measured[t.cur])
+			return t.cur;
+		if (t.cur < t.max && !t.measured[t.cur + 1])
+			return t.cur + 1;
+		if (t.cur > t.min && !t.measured[t.cur - 1])
+			return t.cur - 1;
+
+		best = t.cur;
+		if (t.cur < t.max &&
+		    t.tput[t.cur + 1] > t.tput[best] * HYSTERESIS)
+			best = t.cur + 1;
+		if (t.cur > t.min &&
+		    t.tput[t.cur - 1] > t.tput[best] * HYSTERESIS)
+			best = t.cur - 1;
+		if (best == t.cur)
+			return -1;
+		t.cur = best;
+	}
+}
+
+static void probe(void)
+{
+	t.stable = 0;
+	t.trial = next_trial();
+	if (t.trial >= 0)
+		return;
+
+	t.stable = 1;
+	t.trial = t.cur;
+	t.best_tput = t.tput[t.cur];
+	t.since_check = 0;
+	PR("Chunk tuner: using %zu KiB (%.1f MiB/s)\n",
+	   ((size_t)1 << t.cur) / 1024, t.best_tput / (1024 * 1024));
+}
+
+static void restart(void)
+{
+	memset(t.measured, 0, sizeof(t.measured));
+	probe();
+}
+
+void tuner_init(size_t min, size_t max, size_t start)
+{
+	memset(&t, 0, sizeof(t));
+	t.min = shift_of(min);
+	t.max = shift_of(max);
+	t.cur = shift_of(start);
+	if (t.cur < t.min)
+		t.cur = t.min;
+	if (t.cur > t.max)
+		t.cur = t.max;
+	restart();
+}
+
+size_t tuner_chunk_size(void)
+{
+	return (size_t)1 << t.trial;
+}
+
+void tuner_record(size_t bytes, double secs)
+{
+	double tput;
+
+	t.bytes += bytes;
+	t.secs += secs;
+	t.invokes++;
+	if (t.invokes < SAMPLE_INVOKES || t.bytes < SAMPLE_BYTES ||
+	    t.secs <= 0)
+		return;
+
+	tput = t.bytes / t.secs;
+	PR("Chunk tuner: %zu KiB: %u invokes, %.2f ms/invoke, %.1f MiB/s\n",
+	   tuner_chunk_size() / 1024, t.invokes, t.secs * 1000 / t.invokes,
+	   tput / (1024 * 1024));
+	t.tput[t.trial] = tput;
+	t.measured[t.trial] = 1;
+	t.since_check += t.bytes;
+	t.bytes = 0;
+	t.secs = 0;
+	t.invokes = 0;
+
+	if (!t.stable) {
+		probe();
+	} else if (tput < t.best_tput * DRIFT) {
+		PR("Chunk tuner: throughput dropped, probing again\n");
+		restart();
+	} else if (t.since_check >= RECHECK_BYTES) {
+		PR("Chunk tuner: periodic check\n");
+		restart();
+	}
+}
+
+int tuner_limit(size_t max)
+{
+	int s = shift_of(max);
+
+	if (s < t.min) {
+		PR("Chunk tuner: %zu KiB is below the minimum, giving up\n",
+		   max / 1024);
+		return -1;
+	}
+	if (s >= t.max)
+		return 0;
+	t.max = s;
+	if (t.cur > t.max)
+		t.cur = t.max;
+	PR("Chunk tuner: limited to %zu KiB\n", ((size_t)1 << t.max) / 1024);
+	restart();
+	return 0;
+}
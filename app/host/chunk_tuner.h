@@ -0,0 +1,54 @@
+/*
+ * Copyright (c) 2015, Linaro Limited
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef CHUNK_TUNER_H
+#define CHUNK_TUNER_H
+
+#include <stddef.h>
+
+/*
+ * Picks the size of the data chunks sent to the TA (-b auto)
+ *
+ * Power-of-two sizes are measured in turn, starting from the initial one,
+ * and the tuner climbs towards the size with the best throughput. Once it
+ * has converged it keeps measuring, and probes again when throughput drops
+ * or after a while, so that it follows changing conditions. Measurements
+ * and decisions are logged to stdout.
+ */
+
+void tuner_init(size_t min, size_t max, size_t start);
+/* Size to use for the next invoke */
+size_t tuner_chunk_size(void);
+/* Account for an invoke that sent 'bytes' in 'secs' seconds */
+void tuner_record(size_t bytes, double secs);
+/*
+ * Sizes above 'max' cannot be used (e.g. shared memory is exhausted).
+ * Returns -1 if that leaves no size in the tuner's range, in which case it
+ * must not be used any more.
+ */
+int tuner_limit(size_t max);
+
+#endif /* CHUNK_TUNER_H */
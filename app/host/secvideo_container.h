@@ -0,0 +1,102 @@
+/*
+ * Copyright (c) 2015, Linaro Limited
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef SECVIDEO_CONTAINER_H
+#define SECVIDEO_CONTAINER_H
+
+/*
+ * Encrypted video container, as written by secvideo_pack
+ *
+ *   +--------------------------+ 0
+ *   | struct svc_header        |
+ *   +--------------------------+ aligned on header.frame_align
+ *   | frame 0 payload          |
+ *   +--------------------------+ aligned on header.frame_align
+ *   | ...                      |
+ *   +--------------------------+ header.index_offset
+ *   | struct svc_index_entry   |
+ *   |   x header.frame_count   |
+ *   +--------------------------+
+ *
+ * All integers are little-endian. Frames are encrypted independently so
+ * that any of them can be decrypted (and packed) on its own. With AES-CTR,
+ * the counter block of frame N is nonce[0..7] | N (32-bit big-endian) |
+ * block number within the frame (32-bit big-endian).
+ */
+
+#include <stdint.h>
+#include <string.h>
+
+#define SVC_MAGIC	"SECVIDC1"
+#define SVC_VERSION	1
+
+/* Pixel formats */
+#define SVC_PIXFMT_RGBA8888	0
+
+/* Cipher modes (128-bit key) */
+#define SVC_CIPHER_NONE		0
+#define SVC_CIPHER_AES_ECB	1
+#define SVC_CIPHER_AES_CTR	2
+
+struct svc_header {
+	char magic[8];
+	uint32_t version;
+	uint32_t header_size;	/* sizeof(struct svc_header) */
+	uint32_t width;
+	uint32_t height;
+	uint32_t pixfmt;
+	uint32_t cipher;
+	uint8_t nonce[8];	/* AES-CTR only, zero otherwise */
+	uint32_t frame_count;
+	uint32_t frame_align;	/* Alignment of frame payloads in the file */
+	uint64_t index_offset;
+	uint8_t reserved[8];
+};
+
+struct svc_index_entry {
+	uint64_t offset;	/* From the start of the file */
+	uint32_t size;
+	uint32_t reserved;
+};
+
+/* AES-CTR counter block for byte offset 'offset' (a multiple of 16) */
+static inline void svc_frame_iv(const struct svc_header *hdr, uint32_t frame,
+				uint32_t offset, uint8_t iv[16])
+{
+	uint32_t block = offset / 16;
+
+	memcpy(iv, hdr->nonce, 8);
+	iv[8] = frame >> 24;
+	iv[9] = frame >> 16;
+	iv[10] = frame >> 8;
+	iv[11] = frame;
+	iv[12] = block >> 24;
+	iv[13] = block >> 16;
+	iv[14] = block >> 8;
+	iv[15] = block;
+}
+
+#endif /* SECVIDEO_CONTAINER_H */
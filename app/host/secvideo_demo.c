@@ -28,16 +28,22 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <err.h>
+#include <errno.h>
 #include <assert.h>
 #include <string.h>
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
 #include <sys/ioctl.h>
 #include <sys/mman.h>
 #include <tee_client_api.h>
 #include <secvideo_demo_ta.h>
 #include <secfb_ioctl.h>
+#include "secvideo_container.h"
+#include "shm_pool.h"
+#include "chunk_tuner.h"
 
 #define MIN(a,b) (((a)<(b))?(a):(b))
 
@@ -62,27 +68,79 @@
 /* Globals */
 static TEEC_Context ctx;
 static TEEC_Session sess;
-static TEEC_SharedMemory shm = {
-	.size =  512 * 1024,
-	.flags = TEEC_MEM_INPUT,
-};
+static size_t shm_size = 512 * 1024;
+static TEEC_SharedMemory *shm;	/* From the pool while a file is displayed */
+static int auto_chunk;		/* -b auto: shm_size is chosen by the tuner */
+
+/* Range explored by -b auto */
+#define AUTO_CHUNK_MIN	(16 * 1024)
+#define AUTO_CHUNK_MAX	(2 * 1024 * 1024)
 static TEEC_SharedMemory outm = {
 	.flags = TEEC_MEM_OUTPUT | TEEC_MEM_DMABUF | TEEC_MEM_SECURE,
 };
+static int secfb_dev = -1;	/* Kept open for SECFB_IOCTL_SYNC */
+/* Source geometry and destination rectangle when the TA scales the image */
+static struct scale_params {
+	uint32_t src_w, src_h;	/* 0: no scaling */
+	uint32_t filter;
+	uint32_t dst_x, dst_y, dst_w, dst_h;
+} scale = {
+	.filter = SCALE_FILTER_BILINEAR,
+	.dst_w = FB_WIDTH,
+	.dst_h = FB_HEIGHT,
+};
+/* Container playback: first frame and number of frames (0: until the end) */
+static uint32_t first_frame;
+static uint32_t frame_count;
 
 #define FP(args...) do { fprintf(stderr, args); } while(0)
 
 static void usage()
 {
-	FP("Usage: secvideo_demo [-b <size>] [-r] [-c|<file>] ...\n");
+	FP("Usage: secvideo_demo [-b <size>] [-k <X>,<Y>,<W>x<H>[=<hex>]] "
+				"[-m] [-r] [-S <file>]\n");
+	FP("                     [-p <pattern>] "
+				"[-s <W>x<H> [-f <filter>] [-d <X>,<Y>,<W>x<H>]]\n");
+	FP("                     [-F <frame>] [-n <count>] [-c|<file>] ...\n");
 	FP("       secvideo_demo -h\n");
 	FP(" -b       Size of the non-secure buffer "
-				"(TEEC_AllocateSharedMemory()) [%zd].\n",
-				shm.size);
+				"(TEEC_AllocateSharedMemory(), reused\n");
+	FP("          from a pool) [%zd].\n", shm_size);
+	FP("          'auto' measures invokes and adjusts the size at run "
+				"time.\n");
 	FP(" -c       Clear the FVP LCD screen.\n");
+	FP(" -k       Print the digest of a framebuffer rectangle, computed "
+				"by the trusted\n");
+	FP("          app (X,Y,WxH, multiples of %d, or up to the edge). If "
+				"=<hex> is\n", CHECKSUM_TILE);
+	FP("          given, exit with an error on mismatch.\n");
+	FP(" -m       Show the memory footprint of the trusted app.\n");
+	FP(" -p       Have the trusted app draw a test pattern (bars, gradient, "
+				"checker or\n");
+	FP("          box) -n times [1] and report the frame rate.\n");
 	FP(" -ns      Do not make output memory secure\n");
 	FP(" -r       Try to read back from output memory\n");
-	FP(" <file>   Display file (800x600 32-bit RGBA, A is ignored).\n");
+	FP(" -S       Save the framebuffer to a raw RGBA file (a screenshot, "
+				"only useful\n");
+	FP("          with -ns).\n");
+	FP(" -s       Source image size. The trusted app scales it to the "
+				"destination\n");
+	FP("          rectangle. Source width is at most 1920.\n");
+	FP(" -f       Scaling filter: nearest or bilinear [bilinear].\n");
+	FP(" -d       Destination rectangle [0,0,%dx%d].\n", FB_WIDTH,
+				FB_HEIGHT);
+	FP(" -F       First frame to play from a container [0].\n");
+	FP(" -n       Number of frames to play from a container, wrapping "
+				"around at the\n");
+	FP("          end [until the last frame], or to draw with -p. Unlike "
+				"the other\n");
+	FP("          options, it applies to the whole command line, wherever "
+				"it is, and\n");
+	FP("          the last -n wins.\n");
+	FP(" <file>   Display file. Either a container made by secvideo_pack, "
+				"or a raw\n");
+	FP("          image (800x600 32-bit RGBA, A is ignored, or the size "
+				"given with -s).\n");
 	FP("          If extension is .aes, the file is assumed to be "
 				"encrypted with 128-bit\n");
 	FP("          AES-ECB, no IV, no padding, "
@@ -115,30 +173,68 @@ static void clear_screen(uint32_t color)
 	CHECK_INVOKE(res, err_origin);
 }
 
+static void show_mem_stats(void)
+{
+	TEEC_Result res;
+	TEEC_Operation op;
+	uint32_t err_origin;
+
+	memset(&op, 0, sizeof(op));
+	op.paramTypes = TEEC_PARAM_TYPES(TEEC_VALUE_OUTPUT, TEEC_VALUE_OUTPUT,
+					 TEEC_VALUE_OUTPUT, TEEC_NONE);
+
+	res = TEEC_InvokeCommand(&sess, TA_SECVIDEO_DEMO_GET_MEM_STATS, &op,
+				 &err_origin);
+	CHECK_INVOKE(res, err_origin);
+	PR("TA heap: %u bytes in use, max sampled heap use %u bytes\n",
+	   op.params[0].value.a, op.params[0].value.b);
+	PR("TA stack: %u bytes at peak (%u at most can be measured)\n",
+	   op.params[1].value.a, op.params[1].value.b);
+	PR("TA scaler arena: %u bytes at peak (out of %u)\n",
+	   op.params[2].value.a, op.params[2].value.b);
+}
+
 static void allocate_outputmem(void)
 {
-	int ret, secfb_dev;
+	int ret;
 	struct secfb_io secfb;
 	void *mmaped;
 	TEEC_Result res;
 
+	/* Registered once, then kept until exit */
+	if (outm.buffer)
+		return;
+
 	secfb_dev = open("/dev/secfb", 0);
 	if (secfb_dev < 0) {
 		perror("open");
 		return;
 	}
+	/*
+	 * Only read by the CPU: cached, with SECFB_IOCTL_SYNC around reads,
+	 * unless the driver cannot sync the buffer
+	 */
+	memset(&secfb, 0, sizeof(secfb));
+	secfb.flags = SECFB_MAP_CACHED;
 	ret = ioctl(secfb_dev, SECFB_IOCTL_GET_SECFB_FD, &secfb);
+	if (ret < 0 && errno == EOPNOTSUPP) {
+		PR("Note: FB cannot be cached, mapping it write-combined\n");
+		memset(&secfb, 0, sizeof(secfb));
+		secfb.flags = SECFB_MAP_WC;
+		ret = ioctl(secfb_dev, SECFB_IOCTL_GET_SECFB_FD, &secfb);
+	}
 	if (ret < 0) {
 		perror("ioctl");
-		return;
+		goto close_dev;
 	}
 	PR("Note: FB size is %zd bytes\n", secfb.size);
 
 	mmaped = mmap(NULL, secfb.size, PROT_WRITE|PROT_READ, MAP_SHARED,
 			   secfb.fd, 0);
-	if (!mmaped) {
+	if (mmaped == MAP_FAILED) {
 		perror("mmap");
-		return;
+		close(secfb.fd);
+		goto close_dev;
 	}
 	outm.buffer = mmaped;
 	outm.size = secfb.size;
@@ -146,61 +242,365 @@ static void allocate_outputmem(void)
 	outm.d.fd = secfb.fd;
 	res = TEEC_RegisterSharedMemory(&ctx, &outm);
 	CHECK(res, "TEEC_RegisterSharedMemory");
+	return;
+
+close_dev:
+	close(secfb_dev);
+	secfb_dev = -1;
 }
 
-static void allocate_mem(void)
+/* Cache maintenance before (SECFB_SYNC_START) or after CPU access */
+static void sync_outputmem(uint64_t flags, size_t offset, size_t len)
 {
-	TEEC_Result res;
+	struct secfb_sync sync = {
+		.flags = flags,
+		.offset = offset,
+		.len = len,
+		.fd = outm.d.fd,
+	};
+
+	if (ioctl(secfb_dev, SECFB_IOCTL_SYNC, &sync) < 0)
+		warn("SECFB_IOCTL_SYNC");
+}
 
-	PR("Request shared memory (%zd bytes)...\n", shm.size);
-	res = TEEC_AllocateSharedMemory(&ctx, &shm);
-	CHECK(res, "TEEC_AllocateSharedMemory");
+static void allocate_mem(void)
+{
+	PR("Request shared memory (%zd bytes)...\n", shm_size);
+	shm = shm_pool_get(shm_size, TEEC_MEM_INPUT);
+	if (!shm)
+		errx(1, "Cannot get %zd bytes of shared memory", shm_size);
 	PR("Request output memory...\n");
 	allocate_outputmem();
 }
 
+/* Give the input buffer back to the pool, it stays registered */
+static void release_mem(void)
+{
+	shm_pool_put(shm);
+	shm = NULL;
+}
+
 static void free_mem(void)
 {
+	struct shm_pool_stats st;
+
+	shm_pool_get_stats(&st);
+	PR("Shared memory pool: %lu hits, %lu misses, %zd bytes allocated\n",
+	   st.hits, st.misses, st.bytes_allocated);
 	PR("Release shared memory...\n");
-	TEEC_ReleaseSharedMemory(&shm);
-	PR("Release secure memory...\n");
-	TEEC_ReleaseSharedMemory(&outm);
+	shm_pool_destroy();
+	if (outm.buffer) {
+		PR("Release secure memory...\n");
+		TEEC_ReleaseSharedMemory(&outm);
+	}
+	if (secfb_dev >= 0)
+		close(secfb_dev);
 }
 
-static size_t send_image_data(size_t sz, size_t offset, int flags)
+static void set_scaler(void)
 {
 	TEEC_Result res;
 	TEEC_Operation op;
 	uint32_t err_origin;
 
+	memset(&op, 0, sizeof(op));
+	op.paramTypes = TEEC_PARAM_TYPES(TEEC_VALUE_INPUT, TEEC_VALUE_INPUT,
+					 TEEC_NONE, TEEC_NONE);
+	op.params[0].value.a = scale.src_w | scale.src_h << 16;
+	op.params[0].value.b = scale.filter;
+	op.params[1].value.a = scale.dst_x | scale.dst_y << 16;
+	op.params[1].value.b = scale.dst_w | scale.dst_h << 16;
+
+	PR("Invoke SET_SCALER command (%ux%u to %ux%u at %u,%u)...\n",
+	   scale.src_w, scale.src_h, scale.dst_w, scale.dst_h, scale.dst_x,
+	   scale.dst_y);
+	res = TEEC_InvokeCommand(&sess, TA_SECVIDEO_DEMO_SET_SCALER, &op,
+				 &err_origin);
+	CHECK_INVOKE(res, err_origin);
+}
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/*
+ * Size of the next chunk to send. With -b auto, it comes from the tuner and
+ * the input buffer is swapped for a larger one from the pool when needed.
+ */
+static size_t next_chunk_size(void)
+{
+	TEEC_SharedMemory *m;
+	size_t sz;
+
+	if (!auto_chunk)
+		return shm_size;
+
+	while ((sz = tuner_chunk_size()) > shm->size) {
+		m = shm_pool_get(sz, TEEC_MEM_INPUT);
+		if (m) {
+			shm_pool_put(shm);
+			shm = m;
+			break;
+		}
+		if (tuner_limit(sz / 2)) {
+			/* Keep the buffer we have, at a fixed size */
+			auto_chunk = 0;
+			shm_size = shm->size;
+			return shm_size;
+		}
+	}
+	return sz;
+}
+
+static size_t send_image_data(size_t sz, size_t offset, int flags,
+			      uint8_t *iv)
+{
+	TEEC_Result res;
+	TEEC_Operation op;
+	uint32_t err_origin;
+	double t0;
+
 	op.paramTypes = TEEC_PARAM_TYPES(TEEC_MEMREF_PARTIAL_INPUT,
 					 TEEC_VALUE_INPUT, TEEC_MEMREF_WHOLE,
-					 TEEC_NONE);
+					 iv ? TEEC_MEMREF_TEMP_INPUT : TEEC_NONE);
 	/* TA input buffer */
-	op.params[0].memref.parent = &shm;
+	op.params[0].memref.parent = shm;
 	op.params[0].memref.offset = 0;
 	op.params[0].memref.size = sz;
 	op.params[1].value.a = offset;
 	op.params[1].value.b = flags;
 	/* TA output buffer */
 	op.params[2].memref.parent = &outm;
+	/* AES-CTR counter block */
+	op.params[3].tmpref.buffer = iv;
+	op.params[3].tmpref.size = 16;
 
+	t0 = now();
 	res = TEEC_InvokeCommand(&sess, TA_SECVIDEO_DEMO_IMAGE_DATA, &op,
 				 &err_origin);
 	CHECK_INVOKE(res, err_origin);
+	if (auto_chunk)
+		tuner_record(sz, now() - t0);
 
 	return sz;
 }
 
+/*
+ * Draw a test pattern frame_count times in the TA, to measure the secure
+ * framebuffer fill rate on its own
+ */
+static void draw_pattern(const char *name)
+{
+	static const char * const names[] = {
+		[PATTERN_COLOR_BARS] = "bars",
+		[PATTERN_GRADIENT] = "gradient",
+		[PATTERN_CHECKERBOARD] = "checker",
+		[PATTERN_MOVING_BOX] = "box",
+	};
+	TEEC_Result res;
+	TEEC_Operation op;
+	uint32_t err_origin;
+	uint32_t pattern, i, n = frame_count ? frame_count : 1;
+	double t0, secs;
+
+	for (pattern = 0; pattern < sizeof(names) / sizeof(names[0]);
+	     pattern++)
+		if (!strcmp(name, names[pattern]))
+			break;
+	if (pattern == sizeof(names) / sizeof(names[0]))
+		errx(1, "Unknown pattern: %s", name);
+
+	allocate_outputmem();
+
+	memset(&op, 0, sizeof(op));
+	op.paramTypes = TEEC_PARAM_TYPES(TEEC_VALUE_INPUT, TEEC_MEMREF_WHOLE,
+					 TEEC_NONE, TEEC_NONE);
+	op.params[0].value.a = pattern;
+	op.params[1].memref.parent = &outm;
+
+	PR("Invoke PATTERN command (%s, %u frames)...\n", name, n);
+	t0 = now();
+	for (i = 0; i < n; i++) {
+		op.params[0].value.b = i;
+		res = TEEC_InvokeCommand(&sess, TA_SECVIDEO_DEMO_PATTERN, &op,
+					 &err_origin);
+		CHECK_INVOKE(res, err_origin);
+	}
+	secs = now() - t0;
+	PR("%u frames in %.3f s: %.1f frames/s, %.1f MiB/s\n", n, secs,
+	   n / secs, (double)n * FB_WIDTH * FB_HEIGHT * FB_BPP /
+	   (1024 * 1024) / secs);
+}
+
+/*
+ * Digest of a framebuffer rectangle, computed by the TA. The spec is
+ * X,Y,WxH, with an optional =<hex digest> to compare against.
+ */
+static void checksum_rect(const char *spec)
+{
+	TEEC_Result res;
+	TEEC_Operation op;
+	uint32_t err_origin;
+	unsigned int x, y, w, h, v;
+	uint8_t digest[CHECKSUM_SIZE], expected[CHECKSUM_SIZE];
+	const char *hex;
+	int n = 0, i;
+
+	if (sscanf(spec, "%u,%u,%ux%u%n", &x, &y, &w, &h, &n) != 4 || !n ||
+	    (spec[n] && spec[n] != '='))
+		errx(1, "Invalid rectangle: %s", spec);
+	if ((x | y) % CHECKSUM_TILE ||
+	    (w % CHECKSUM_TILE && x + w != FB_WIDTH) ||
+	    (h % CHECKSUM_TILE && y + h != FB_HEIGHT))
+		errx(1, "Rectangle must be made of %dx%d tiles: %s",
+		     CHECKSUM_TILE, CHECKSUM_TILE, spec);
+	hex = spec[n] ? spec + n + 1 : NULL;
+	if (hex) {
+		if (strlen(hex) != 2 * CHECKSUM_SIZE)
+			errx(1, "Invalid digest: %s", hex);
+		for (i = 0; i < CHECKSUM_SIZE; i++) {
+			if (sscanf(hex + 2 * i, "%2x", &v) != 1)
+				errx(1, "Invalid digest: %s", hex);
+			expected[i] = v;
+		}
+	}
+
+	allocate_outputmem();
+
+	memset(&op, 0, sizeof(op));
+	op.paramTypes = TEEC_PARAM_TYPES(TEEC_VALUE_INPUT, TEEC_MEMREF_WHOLE,
+					 TEEC_MEMREF_TEMP_OUTPUT, TEEC_NONE);
+	op.params[0].value.a = x | y << 16;
+	op.params[0].value.b = w | h << 16;
+	op.params[1].memref.parent = &outm;
+	op.params[2].tmpref.buffer = digest;
+	op.params[2].tmpref.size = sizeof(digest);
+
+	res = TEEC_InvokeCommand(&sess, TA_SECVIDEO_DEMO_CHECKSUM_RECT, &op,
+				 &err_origin);
+	CHECK_INVOKE(res, err_origin);
+	PR("Digest of %ux%u at %u,%u: ", w, h, x, y);
+	for (i = 0; i < CHECKSUM_SIZE; i++)
+		PR("%02x", digest[i]);
+	PR("\n");
+	if (hex && memcmp(digest, expected, sizeof(digest)))
+		errx(1, "Digest mismatch (expected %s)", hex);
+}
+
+static const struct svc_header *check_container(const void *map, size_t sz)
+{
+	const struct svc_header *hdr = map;
+	const struct svc_index_entry *idx;
+	uint64_t frame_sz;
+	uint32_t i;
+
+	if (sz < sizeof(*hdr) || memcmp(hdr->magic, SVC_MAGIC, 8))
+		return NULL;
+	if (hdr->version != SVC_VERSION || hdr->header_size != sizeof(*hdr))
+		errx(1, "Unsupported container version");
+	if (hdr->pixfmt != SVC_PIXFMT_RGBA8888 ||
+	    hdr->cipher > SVC_CIPHER_AES_CTR)
+		errx(1, "Unsupported pixel format or cipher");
+	/* RGBA8888, so that every frame is exactly width x height pixels */
+	frame_sz = (uint64_t)hdr->width * hdr->height * 4;
+	if (!frame_sz || frame_sz > UINT32_MAX)
+		errx(1, "Invalid frame geometry %ux%u", hdr->width,
+		     hdr->height);
+	if (hdr->cipher == SVC_CIPHER_AES_ECB && frame_sz % 16)
+		errx(1, "AES-ECB frames are not whole blocks");
+	if (!hdr->frame_count || hdr->index_offset > sz ||
+	    (sz - hdr->index_offset) / sizeof(*idx) < hdr->frame_count)
+		errx(1, "Truncated container");
+	idx = (const void *)((const uint8_t *)map + hdr->index_offset);
+	for (i = 0; i < hdr->frame_count; i++) {
+		if (idx[i].offset > sz || sz - idx[i].offset < idx[i].size)
+			errx(1, "Frame %u is out of bounds", i);
+		if (idx[i].size != frame_sz)
+			errx(1, "Frame %u is %u bytes, not %ux%u", i,
+			     idx[i].size, hdr->width, hdr->height);
+	}
+	return hdr;
+}
+
+/* Have the kernel read ahead a frame while we send the current one */
+static void prefetch_frame(const void *map, const struct svc_index_entry *e)
+{
+	uintptr_t mask = sysconf(_SC_PAGESIZE) - 1;
+	uintptr_t start = ((uintptr_t)map + e->offset) & ~mask;
+	uintptr_t end = (uintptr_t)map + e->offset + e->size;
+
+	madvise((void *)start, end - start, MADV_WILLNEED);
+}
+
+/* Play frames from a container, accessed through mmap() */
+static void play_container(const void *map, size_t map_sz)
+{
+	const struct svc_header *hdr = map;
+	const struct svc_index_entry *idx, *e;
+	/* The container's geometry only applies to this file */
+	const struct scale_params saved_scale = scale;
+	size_t sz, offset;
+	uint32_t i, n, frame;
+	uint8_t iv[16];
+	int flags, base_flags = 0;
+
+	idx = (const void *)((const uint8_t *)map + hdr->index_offset);
+	PR("Container: %u frames, %ux%u, cipher %u\n", hdr->frame_count,
+	   hdr->width, hdr->height, hdr->cipher);
+
+	if (first_frame >= hdr->frame_count)
+		errx(1, "First frame %u is past the end", first_frame);
+	n = frame_count ? frame_count : hdr->frame_count - first_frame;
+
+	if (hdr->width != FB_WIDTH || hdr->height != FB_HEIGHT ||
+	    scale.dst_x || scale.dst_y || scale.dst_w != FB_WIDTH ||
+	    scale.dst_h != FB_HEIGHT) {
+		scale.src_w = hdr->width;
+		scale.src_h = hdr->height;
+		set_scaler();
+		base_flags |= IMAGE_SCALE;
+	}
+	if (hdr->cipher != SVC_CIPHER_NONE)
+		base_flags |= IMAGE_ENCRYPTED;
+	if (hdr->cipher == SVC_CIPHER_AES_CTR)
+		base_flags |= IMAGE_CTR;
+
+	for (i = 0; i < n; i++) {
+		frame = (first_frame + i) % hdr->frame_count;
+		e = &idx[frame];
+		prefetch_frame(map, &idx[(frame + 1) % hdr->frame_count]);
+
+		PR("Frame %u (%u bytes)\n", frame, e->size);
+		for (offset = 0; offset < e->size; offset += sz) {
+			sz = MIN(next_chunk_size() & ~(size_t)15,
+				 e->size - offset);
+			memcpy(shm->buffer, (const uint8_t *)map + e->offset +
+			       offset, sz);
+			flags = base_flags;
+			if (!offset)
+				flags |= IMAGE_START;
+			if (offset + sz == e->size)
+				flags |= IMAGE_END;
+			if (flags & IMAGE_CTR)
+				svc_frame_iv(hdr, frame, offset, iv);
+			send_image_data(sz, offset, flags,
+					(flags & IMAGE_CTR) ? iv : NULL);
+		}
+	}
+	scale = saved_scale;
+}
+
 static void display_file(const char *name)
 {
 	FILE *f;
 	long file_sz;
 	size_t sz, left, offset = 0;
 	int crypt, flags;
-
-	if (!shm.buffer)
-		allocate_mem();
+	void *map;
 
 	PR("Open file '%s'\n", name);
 
@@ -209,30 +609,61 @@ static void display_file(const char *name)
 		perror("fopen");
 		return;
 	}
+	allocate_mem();
 	fseek(f, 0, SEEK_END);
 	file_sz = ftell(f);
 	rewind(f);
 
+	if (file_sz > 0) {
+		map = mmap(NULL, file_sz, PROT_READ, MAP_SHARED, fileno(f), 0);
+		if (map == MAP_FAILED) {
+			perror("mmap");
+			release_mem();
+			fclose(f);
+			return;
+		}
+		if (check_container(map, file_sz)) {
+			play_container(map, file_sz);
+			munmap(map, file_sz);
+			release_mem();
+			fclose(f);
+			return;
+		}
+		munmap(map, file_sz);
+	}
+
 	crypt = (strlen(name) > 4 &&
 		 !strncmp(name + strlen(name) - 4, ".aes", 4));
 
+	if (scale.src_w) {
+		if (file_sz != (long)scale.src_w * scale.src_h * 4)
+			PR("Warning: file size does not match %ux%u\n",
+			   scale.src_w, scale.src_h);
+		set_scaler();
+	}
+
 	PR("Send image data to trusted app...\n");
 	for (left = file_sz; left > 0; ) {
-		sz = fread(shm.buffer, 1, shm.size, f);
+		/* May swap shm, so before reading shm->buffer */
+		sz = next_chunk_size();
+		sz = fread(shm->buffer, 1, sz, f);
 		if (sz > 0) {
 			PR("%zd bytes\n", sz);
 			flags = 0;
 			if (crypt)
 				flags |= IMAGE_ENCRYPTED;
+			if (scale.src_w)
+				flags |= IMAGE_SCALE;
 			if (left == file_sz)
 				flags |= IMAGE_START;
 			if (left <= sz)
 				flags |= IMAGE_END;
-			send_image_data(sz, offset, flags);
+			send_image_data(sz, offset, flags, NULL);
 			left -= sz;
 			offset += sz;
 		}
 	} while (left > 0);
+	release_mem();
 	fclose(f);
 }
 
@@ -241,16 +672,46 @@ static void read_from_outbuf()
 	int i;
 	uint8_t *p;
 
-	if (!outm.d.fd)
-		allocate_outputmem();
+	allocate_outputmem();
+	if (!outm.buffer)
+		return;
 	PR("Trying to read back from frame buffer...\n");
 	p = outm.buffer;
+	sync_outputmem(SECFB_SYNC_START | SECFB_SYNC_READ, 0, 16);
 	for (i = 0; i < 16; i++) {
 		printf("0x%02x ", p[i]);
 	}
+	sync_outputmem(SECFB_SYNC_END | SECFB_SYNC_READ, 0, 16);
 	printf("\n");
 }
 
+/* Write the visible part of the framebuffer to a file in one go */
+static void save_outbuf(const char *name)
+{
+	const size_t sz = FB_WIDTH * FB_HEIGHT * FB_BPP;
+	FILE *f;
+	double t;
+	size_t n;
+
+	allocate_outputmem();
+	if (!outm.buffer)
+		return;
+	f = fopen(name, "wb");
+	if (!f)
+		err(1, "%s", name);
+
+	PR("Saving frame buffer to %s...\n", name);
+	t = now();
+	sync_outputmem(SECFB_SYNC_START | SECFB_SYNC_READ, 0, sz);
+	n = fwrite(outm.buffer, 1, sz, f);
+	sync_outputmem(SECFB_SYNC_END | SECFB_SYNC_READ, 0, sz);
+	if (n != sz || fclose(f))
+		err(1, "%s", name);
+	t = now() - t;
+	PR("%zd bytes in %.2f ms (%.1f MiB/s)\n", sz, t * 1e3,
+	   sz / t / (1024 * 1024));
+}
+
 int main(int argc, char *argv[])
 {
 	TEEC_Result res;
@@ -269,11 +730,19 @@ int main(int argc, char *argv[])
 			return 0;
 		}
 	}
+	/*
+	 * -n applies wherever it is, e.g. to a -p that comes before it, and
+	 * the last one applies to every file and pattern
+	 */
+	for (i = 1; i < argc - 1; i++)
+		if (!strcmp(argv[i], "-n"))
+			frame_count = strtoul(argv[++i], NULL, 0);
 
 	PR("Initialize TEE context...\n");
 	res = TEEC_InitializeContext(NULL, &ctx);
 	if (res != TEEC_SUCCESS)
 		errx(1, "TEEC_InitializeContext failed with code 0x%x", res);
+	shm_pool_init(&ctx);
 
 	PR("Open session to 'secvideo_demo' TA...\n");
 	res = TEEC_OpenSession(&ctx, &sess, &uuid,
@@ -287,10 +756,54 @@ int main(int argc, char *argv[])
 			clear_screen(0x000A0000);
 		} else if (!strcmp(argv[i], "-b")) {
 			++i;
-			shm.size = strtol(argv[i], NULL, 0);
-			PR("Non-secure buffer size: %zd bytes\n", shm.size);
+			auto_chunk = !strcmp(argv[i], "auto");
+			if (auto_chunk) {
+				tuner_init(AUTO_CHUNK_MIN, AUTO_CHUNK_MAX,
+					   shm_size);
+				PR("Non-secure buffer size: auto\n");
+			} else {
+				shm_size = strtol(argv[i], NULL, 0);
+				/* Chunks are whole AES blocks */
+				if (shm_size < 16)
+					errx(1, "Invalid buffer size: %s",
+					     argv[i]);
+				PR("Non-secure buffer size: %zd bytes\n",
+				   shm_size);
+			}
+		} else if (!strcmp(argv[i], "-k")) {
+			checksum_rect(argv[++i]);
+		} else if (!strcmp(argv[i], "-m")) {
+			show_mem_stats();
+		} else if (!strcmp(argv[i], "-p")) {
+			draw_pattern(argv[++i]);
 		} else if (!strcmp(argv[i], "-r")) {
 			read_from_outbuf();
+		} else if (!strcmp(argv[i], "-S")) {
+			save_outbuf(argv[++i]);
+		} else if (!strcmp(argv[i], "-s")) {
+			++i;
+			if (sscanf(argv[i], "%ux%u", &scale.src_w,
+				   &scale.src_h) != 2)
+				errx(1, "Invalid source size: %s", argv[i]);
+		} else if (!strcmp(argv[i], "-f")) {
+			++i;
+			if (!strcmp(argv[i], "nearest"))
+				scale.filter = SCALE_FILTER_NEAREST;
+			else if (!strcmp(argv[i], "bilinear"))
+				scale.filter = SCALE_FILTER_BILINEAR;
+			else
+				errx(1, "Unknown filter: %s", argv[i]);
+		} else if (!strcmp(argv[i], "-d")) {
+			++i;
+			if (sscanf(argv[i], "%u,%u,%ux%u", &scale.dst_x,
+				   &scale.dst_y, &scale.dst_w,
+				   &scale.dst_h) != 4)
+				errx(1, "Invalid destination: %s", argv[i]);
+		} else if (!strcmp(argv[i], "-F")) {
+			++i;
+			first_frame = strtoul(argv[i], NULL, 0);
+		} else if (!strcmp(argv[i], "-n")) {
+			++i;	/* Already parsed */
 		} else if (!strcmp(argv[i], "-ns")) {
 			outm.flags &= ~TEEC_MEM_SECURE;
 		} else {
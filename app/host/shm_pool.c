@@ -0,0 +1,182 @@
+/*
+ * Copyright (c) 2015, Linaro Limited
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <tee_client_api.h>
+#include "shm_pool.h"
+
+#define SHM_POOL_MIN_SHIFT	12	/* 4 KiB */
+#define SHM_POOL_CLASSES	14	/* Up to 32 MiB */
+
+struct shm_pool_buf {
+	TEEC_SharedMemory shm;	/* Must be first */
+	int in_use;
+	int one_off;		/* Too large for the pool, freed when put */
+	struct shm_pool_buf *next;
+};
+
+static struct {
+	TEEC_Context *ctx;
+	struct shm_pool_buf *bufs[SHM_POOL_CLASSES];
+	struct shm_pool_stats stats;
+} pool;
+
+static int size_class(size_t size)
+{
+	int c;
+
+	for (c = 0; c < SHM_POOL_CLASSES; c++)
+		if (size <= (size_t)1 << (SHM_POOL_MIN_SHIFT + c))
+			return c;
+	return -1;
+}
+
+static struct shm_pool_buf *alloc_buf(size_t size, uint32_t flags)
+{
+	struct shm_pool_buf *b;
+
+	b = calloc(1, sizeof(*b));
+	if (!b)
+		return NULL;
+	b->shm.size = size;
+	b->shm.flags = flags;
+	if (TEEC_AllocateSharedMemory(pool.ctx, &b->shm) != TEEC_SUCCESS) {
+		free(b);
+		return NULL;
+	}
+	b->in_use = 1;
+	return b;
+}
+
+/*
+ * Free the buffers nobody holds, so that their memory can be allocated
+ * again in another class. Returns the number of buffers freed.
+ */
+static int release_idle(void)
+{
+	struct shm_pool_buf **pb, *b;
+	int c, n = 0;
+
+	for (c = 0; c < SHM_POOL_CLASSES; c++) {
+		for (pb = &pool.bufs[c]; (b = *pb); ) {
+			if (b->in_use) {
+				pb = &b->next;
+				continue;
+			}
+			*pb = b->next;
+			pool.stats.bytes_allocated -= b->shm.size;
+			TEEC_ReleaseSharedMemory(&b->shm);
+			free(b);
+			n++;
+		}
+	}
+	return n;
+}
+
+/* Shared memory is scarce: retry once without the idle buffers */
+static struct shm_pool_buf *alloc_buf_or_release(size_t size, uint32_t flags)
+{
+	struct shm_pool_buf *b = alloc_buf(size, flags);
+
+	if (!b && release_idle())
+		b = alloc_buf(size, flags);
+	return b;
+}
+
+void shm_pool_init(TEEC_Context *ctx)
+{
+	memset(&pool, 0, sizeof(pool));
+	pool.ctx = ctx;
+}
+
+TEEC_SharedMemory *shm_pool_get(size_t size, uint32_t flags)
+{
+	int c = size_class(size);
+	struct shm_pool_buf *b;
+
+	pool.stats.misses++;
+	if (c < 0) {
+		b = alloc_buf_or_release(size, flags);
+		if (!b)
+			return NULL;
+		b->one_off = 1;
+		return &b->shm;
+	}
+
+	for (b = pool.bufs[c]; b; b = b->next) {
+		if (!b->in_use && b->shm.flags == flags) {
+			b->in_use = 1;
+			pool.stats.misses--;
+			pool.stats.hits++;
+			return &b->shm;
+		}
+	}
+
+	b = alloc_buf_or_release((size_t)1 << (SHM_POOL_MIN_SHIFT + c),
+				 flags);
+	if (!b)
+		return NULL;
+	pool.stats.bytes_allocated += b->shm.size;
+	b->next = pool.bufs[c];
+	pool.bufs[c] = b;
+	return &b->shm;
+}
+
+void shm_pool_put(TEEC_SharedMemory *shm)
+{
+	struct shm_pool_buf *b = (struct shm_pool_buf *)shm;
+
+	if (!b)
+		return;
+	if (b->one_off) {
+		TEEC_ReleaseSharedMemory(&b->shm);
+		free(b);
+		return;
+	}
+	b->in_use = 0;
+}
+
+void shm_pool_get_stats(struct shm_pool_stats *stats)
+{
+	*stats = pool.stats;
+}
+
+void shm_pool_destroy(void)
+{
+	struct shm_pool_buf *b, *next;
+	int c;
+
+	for (c = 0; c < SHM_POOL_CLASSES; c++) {
+		for (b = pool.bufs[c]; b; b = next) {
+			next = b->next;
+			TEEC_ReleaseSharedMemory(&b->shm);
+			free(b);
+		}
+		pool.bufs[c] = NULL;
+	}
+}
@@ -0,0 +1,59 @@
+/*
+ * Copyright (c) 2015, Linaro Limited
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef SHM_POOL_H
+#define SHM_POOL_H
+
+#include <stddef.h>
+#include <tee_client_api.h>
+
+/*
+ * Pool of shared memory buffers
+ *
+ * Buffers are grouped in power-of-two size classes. They are allocated with
+ * TEEC_AllocateSharedMemory(), so that the TEE uses them in place with no
+ * copy on each invoke, the first time a class is needed, and then handed out
+ * again and again until shm_pool_destroy(). Requests larger than the largest
+ * class get a buffer of their own, freed by shm_pool_put(). When an
+ * allocation fails, the buffers not in use are freed and it is tried again,
+ * so that a growing chunk size is not limited by the smaller buffers it
+ * left behind.
+ */
+
+struct shm_pool_stats {
+	unsigned long hits;	/* Requests served by a pooled buffer */
+	unsigned long misses;	/* Requests that needed a new allocation */
+	size_t bytes_allocated;	/* Held by the pool */
+};
+
+void shm_pool_init(TEEC_Context *ctx);
+/* Returns a buffer of at least size bytes, or NULL */
+TEEC_SharedMemory *shm_pool_get(size_t size, uint32_t flags);
+void shm_pool_put(TEEC_SharedMemory *shm);
+void shm_pool_get_stats(struct shm_pool_stats *stats);
+void shm_pool_destroy(void);
+
+#endif /* SHM_POOL_H */
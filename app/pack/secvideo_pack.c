@@ -0,0 +1,274 @@
+/*
+ * Copyright (c) 2015, Linaro Limited
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * secvideo_pack: build a secvideo container (see secvideo_container.h) out of
+ * raw 32-bit RGBA frames. This tool runs on the build machine.
+ *
+ * Frames are encrypted independently, so a pool of threads picks them one
+ * at a time and writes them straight into the memory mapped output file.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <err.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <openssl/evp.h>
+#include "secvideo_container.h"
+
+#define FRAME_ALIGN	4096
+#define MAX_THREADS	64
+
+#define ALIGN(x, a)	(((x) + (a) - 1) & ~((uint64_t)(a) - 1))
+
+#define FP(args...) do { fprintf(stderr, args); } while(0)
+
+/* Same key as the TA. In a real world application, it would be provisioned. */
+static const uint8_t aes_key[] =
+	{ 0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07,
+	  0x08, 0x09, 0x0A, 0x0B, 0x0C, 0x0D, 0x0E, 0x0F };
+
+static struct svc_header hdr;
+static struct svc_index_entry *idx;
+static const uint8_t **frames;	/* Source of each frame */
+static uint8_t *out;		/* Output file mapping */
+static uint32_t next_frame;	/* Next frame to encrypt, shared by workers */
+
+static void usage(void)
+{
+	FP("Usage: secvideo_pack -s <W>x<H> [-c <cipher>] [-j <threads>] "
+				"-o <output> <input> ...\n");
+	FP("       secvideo_pack -h\n");
+	FP(" -s       Frame size. Each input file holds one or more raw "
+				"32-bit RGBA frames.\n");
+	FP(" -c       Cipher: none, ecb or ctr (AES-128) [ctr].\n");
+	FP(" -j       Number of threads [number of online CPUs].\n");
+	FP(" -o       Output container.\n");
+	FP(" -h       This help.\n");
+}
+
+static void *pack_worker(void *arg)
+{
+	const EVP_CIPHER *cipher;
+	EVP_CIPHER_CTX *ctx;
+	uint8_t iv[16];
+	uint8_t *dst;
+	uint32_t f;
+	int len, len2;
+
+	(void)arg;
+
+	if (hdr.cipher == SVC_CIPHER_AES_CTR)
+		cipher = EVP_aes_128_ctr();
+	else
+		cipher = EVP_aes_128_ecb();
+	ctx = EVP_CIPHER_CTX_new();
+	if (!ctx)
+		errx(1, "EVP_CIPHER_CTX_new failed");
+
+	while ((f = __atomic_fetch_add(&next_frame, 1, __ATOMIC_RELAXED)) <
+	       hdr.frame_count) {
+		dst = out + idx[f].offset;
+		if (hdr.cipher == SVC_CIPHER_NONE) {
+			memcpy(dst, frames[f], idx[f].size);
+			continue;
+		}
+		svc_frame_iv(&hdr, f, 0, iv);
+		if (!EVP_EncryptInit_ex(ctx, cipher, NULL, aes_key, iv) ||
+		    !EVP_CIPHER_CTX_set_padding(ctx, 0) ||
+		    !EVP_EncryptUpdate(ctx, dst, &len, frames[f],
+				       idx[f].size) ||
+		    !EVP_EncryptFinal_ex(ctx, dst + len, &len2) ||
+		    (uint32_t)(len + len2) != idx[f].size)
+			errx(1, "Encryption of frame %u failed", f);
+	}
+
+	EVP_CIPHER_CTX_free(ctx);
+	return NULL;
+}
+
+static const uint8_t *map_input(const char *name, size_t *size)
+{
+	struct stat st;
+	void *map;
+	int fd;
+
+	fd = open(name, O_RDONLY);
+	if (fd < 0)
+		err(1, "%s", name);
+	if (fstat(fd, &st) < 0)
+		err(1, "%s", name);
+	*size = st.st_size;
+	if (!*size)
+		errx(1, "%s: empty file", name);
+	map = mmap(NULL, *size, PROT_READ, MAP_PRIVATE, fd, 0);
+	if (map == MAP_FAILED)
+		err(1, "%s", name);
+	madvise(map, *size, MADV_SEQUENTIAL);
+	close(fd);
+	return map;
+}
+
+static void get_nonce(uint8_t *nonce, size_t sz)
+{
+	int fd = open("/dev/urandom", O_RDONLY);
+
+	if (fd < 0 || read(fd, nonce, sz) != (ssize_t)sz)
+		err(1, "/dev/urandom");
+	close(fd);
+}
+
+int main(int argc, char *argv[])
+{
+	pthread_t threads[MAX_THREADS];
+	const char *output = NULL;
+	struct timespec t0, t1;
+	const uint8_t *map;
+	size_t frame_sz, sz;
+	uint64_t off, total;
+	long nthreads;
+	uint32_t n;
+	double secs;
+	int fd, i, first_input;
+
+	memcpy(hdr.magic, SVC_MAGIC, sizeof(hdr.magic));
+	hdr.version = SVC_VERSION;
+	hdr.header_size = sizeof(hdr);
+	hdr.pixfmt = SVC_PIXFMT_RGBA8888;
+	hdr.cipher = SVC_CIPHER_AES_CTR;
+	hdr.frame_align = FRAME_ALIGN;
+	nthreads = sysconf(_SC_NPROCESSORS_ONLN);
+
+	for (i = 1; i < argc && argv[i][0] == '-'; i++) {
+		if (!strcmp(argv[i], "-h")) {
+			usage();
+			return 0;
+		} else if (i + 1 >= argc) {
+			usage();
+			return 1;
+		} else if (!strcmp(argv[i], "-s")) {
+			if (sscanf(argv[++i], "%ux%u", &hdr.width,
+				   &hdr.height) != 2)
+				errx(1, "Invalid frame size: %s", argv[i]);
+		} else if (!strcmp(argv[i], "-c")) {
+			++i;
+			if (!strcmp(argv[i], "none"))
+				hdr.cipher = SVC_CIPHER_NONE;
+			else if (!strcmp(argv[i], "ecb"))
+				hdr.cipher = SVC_CIPHER_AES_ECB;
+			else if (!strcmp(argv[i], "ctr"))
+				hdr.cipher = SVC_CIPHER_AES_CTR;
+			else
+				errx(1, "Unknown cipher: %s", argv[i]);
+		} else if (!strcmp(argv[i], "-j")) {
+			nthreads = strtol(argv[++i], NULL, 0);
+		} else if (!strcmp(argv[i], "-o")) {
+			output = argv[++i];
+		} else {
+			usage();
+			return 1;
+		}
+	}
+	first_input = i;
+	if (!output || first_input == argc || !hdr.width || !hdr.height) {
+		usage();
+		return 1;
+	}
+	if (nthreads < 1)
+		nthreads = 1;
+	if (nthreads > MAX_THREADS)
+		nthreads = MAX_THREADS;
+
+	frame_sz = (size_t)hdr.width * hdr.height * 4;
+	if (hdr.cipher == SVC_CIPHER_AES_ECB && frame_sz % 16)
+		errx(1, "AES-ECB needs a frame size multiple of 16 bytes");
+	if (hdr.cipher == SVC_CIPHER_AES_CTR)
+		get_nonce(hdr.nonce, sizeof(hdr.nonce));
+
+	/* Map the inputs and lay out the frames */
+	for (i = first_input; i < argc; i++) {
+		map = map_input(argv[i], &sz);
+		if (sz % frame_sz)
+			errx(1, "%s: size is not a multiple of %zu bytes",
+			     argv[i], frame_sz);
+		n = sz / frame_sz;
+		frames = realloc(frames, (hdr.frame_count + n) *
+					 sizeof(*frames));
+		if (!frames)
+			err(1, "realloc");
+		while (n--) {
+			frames[hdr.frame_count++] = map;
+			map += frame_sz;
+		}
+	}
+	idx = calloc(hdr.frame_count, sizeof(*idx));
+	if (!idx)
+		err(1, "calloc");
+	off = ALIGN(sizeof(hdr), FRAME_ALIGN);
+	for (n = 0; n < hdr.frame_count; n++) {
+		idx[n].offset = off;
+		idx[n].size = frame_sz;
+		off = ALIGN(off + frame_sz, FRAME_ALIGN);
+	}
+	hdr.index_offset = off;
+	total = off + hdr.frame_count * sizeof(*idx);
+
+	fd = open(output, O_RDWR | O_CREAT | O_TRUNC, 0644);
+	if (fd < 0)
+		err(1, "%s", output);
+	if (ftruncate(fd, total) < 0)
+		err(1, "%s", output);
+	out = mmap(NULL, total, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if (out == MAP_FAILED)
+		err(1, "%s", output);
+	memcpy(out, &hdr, sizeof(hdr));
+	memcpy(out + hdr.index_offset, idx, hdr.frame_count * sizeof(*idx));
+
+	clock_gettime(CLOCK_MONOTONIC, &t0);
+	for (i = 0; i < nthreads; i++)
+		if (pthread_create(&threads[i], NULL, pack_worker, NULL))
+			errx(1, "pthread_create failed");
+	for (i = 0; i < nthreads; i++)
+		pthread_join(threads[i], NULL);
+	clock_gettime(CLOCK_MONOTONIC, &t1);
+
+	if (munmap(out, total) < 0 || close(fd) < 0)
+		err(1, "%s", output);
+
+	secs = (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) / 1e9;
+	printf("%s: %u frames, %.1f MiB in %.3f s (%.1f MiB/s, %ld threads)\n",
+	       output, hdr.frame_count, hdr.frame_count * frame_sz / 1048576.0,
+	       secs, hdr.frame_count * frame_sz / 1048576.0 / secs, nthreads);
+	return 0;
+}
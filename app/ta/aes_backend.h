@@ -0,0 +1,82 @@
+/*
+ * Copyright (c) 2015, Linaro Limited
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef AES_BACKEND_H
+#define AES_BACKEND_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * AES-128 implementations used by the frame path
+ *
+ * Only the TEE backend depends on the TEE Internal API, so the others can
+ * also be built natively for benchmarking (see app/bench). Operations
+ * return 0 on success. Lengths passed to ecb_decrypt() must be a multiple
+ * of AES_BLOCK_SIZE; ctr_crypt() accepts any length and advances ctr by
+ * the number of whole blocks processed, like aes_ctr_add().
+ */
+
+#define AES_BLOCK_SIZE		16
+#define AES_KEY_SIZE		16
+#define AES_ROUND_KEY_WORDS	44
+
+struct aes_backend {
+	const char *name;
+	/* Non-zero if the backend is built in and can run on this CPU */
+	int (*probe)(void);
+	int (*set_key)(const uint8_t key[AES_KEY_SIZE]);
+	/* Forget the key and free any resources */
+	void (*release)(void);
+	int (*ecb_decrypt)(const uint8_t *in, uint8_t *out, size_t len);
+	int (*ctr_crypt)(uint8_t ctr[AES_BLOCK_SIZE], const uint8_t *in,
+			 uint8_t *out, size_t len);
+};
+
+/* ARMv8 Crypto Extensions, only when built for a CPU that has them */
+extern const struct aes_backend aes_backend_ce;
+/* Cipher operations of the TEE Internal API */
+extern const struct aes_backend aes_backend_tee;
+/* Portable, constant time (bitsliced S-box, no lookup tables) */
+extern const struct aes_backend aes_backend_soft;
+
+/* Key schedule, as little-endian column words, shared by ce and soft */
+void aes_expand_key(const uint8_t key[AES_KEY_SIZE],
+		    uint32_t rk[AES_ROUND_KEY_WORDS]);
+
+/* Add a number of blocks to a big-endian AES-CTR counter block */
+static inline void aes_ctr_add(uint8_t ctr[AES_BLOCK_SIZE], size_t blocks)
+{
+	int i;
+
+	for (i = AES_BLOCK_SIZE - 1; i >= 0 && blocks; i--) {
+		blocks += ctr[i];
+		ctr[i] = blocks;
+		blocks >>= 8;
+	}
+}
+
+#endif /* AES_BACKEND_H */
@@ -0,0 +1,180 @@
+/*
+ * Copyright (c) 2015, Linaro Limited
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * AES-128 with the ARMv8 Crypto Extensions
+ *
+ * Built only when the compiler targets a CPU with the AES instructions
+ * (e.g. -march=armv8-a+crypto, or -mfpu=crypto-neon-fp-armv8 on AArch32);
+ * otherwise probe() fails and the next backend is used. Four blocks are
+ * kept in flight to hide the latency of the AES instructions.
+ */
+
+#include <string.h>
+#include "aes_backend.h"
+
+#if defined(__ARM_FEATURE_CRYPTO) || defined(__ARM_FEATURE_AES)
+#include <arm_neon.h>
+
+static uint8x16_t ek[11];	/* Encryption round keys */
+static uint8x16_t dk[11];	/* Equivalent inverse cipher round keys */
+
+static int ce_probe(void)
+{
+	return 1;
+}
+
+static int ce_set_key(const uint8_t key[AES_KEY_SIZE])
+{
+	uint32_t rk[AES_ROUND_KEY_WORDS];
+	uint8_t b[AES_BLOCK_SIZE];
+	int i, j;
+
+	aes_expand_key(key, rk);
+	for (i = 0; i < 11; i++) {
+		for (j = 0; j < AES_BLOCK_SIZE; j++)
+			b[j] = rk[4 * i + j / 4] >> (8 * (j % 4));
+		ek[i] = vld1q_u8(b);
+	}
+	dk[0] = ek[10];
+	for (i = 1; i < 10; i++)
+		dk[i] = vaesimcq_u8(ek[10 - i]);
+	dk[10] = ek[0];
+
+	memset(rk, 0, sizeof(rk));
+	memset(b, 0, sizeof(b));
+	return 0;
+}
+
+static void ce_release(void)
+{
+	memset(ek, 0, sizeof(ek));
+	memset(dk, 0, sizeof(dk));
+}
+
+static void encrypt4(uint8x16_t s[4])
+{
+	int r, i;
+
+	for (r = 0; r < 9; r++)
+		for (i = 0; i < 4; i++)
+			s[i] = vaesmcq_u8(vaeseq_u8(s[i], ek[r]));
+	for (i = 0; i < 4; i++)
+		s[i] = veorq_u8(vaeseq_u8(s[i], ek[9]), ek[10]);
+}
+
+static void decrypt4(uint8x16_t s[4])
+{
+	int r, i;
+
+	for (r = 0; r < 9; r++)
+		for (i = 0; i < 4; i++)
+			s[i] = vaesimcq_u8(vaesdq_u8(s[i], dk[r]));
+	for (i = 0; i < 4; i++)
+		s[i] = veorq_u8(vaesdq_u8(s[i], dk[9]), dk[10]);
+}
+
+static int ce_ecb_decrypt(const uint8_t *in, uint8_t *out, size_t len)
+{
+	uint8x16_t s[4];
+	size_t n, i;
+
+	if (len % AES_BLOCK_SIZE)
+		return -1;
+
+	while (len) {
+		n = len / AES_BLOCK_SIZE < 4 ? len / AES_BLOCK_SIZE : 4;
+		for (i = 0; i < 4; i++)
+			s[i] = vld1q_u8(in + AES_BLOCK_SIZE * (i < n ? i : 0));
+		decrypt4(s);
+		for (i = 0; i < n; i++)
+			vst1q_u8(out + AES_BLOCK_SIZE * i, s[i]);
+		in += AES_BLOCK_SIZE * n;
+		out += AES_BLOCK_SIZE * n;
+		len -= AES_BLOCK_SIZE * n;
+	}
+	return 0;
+}
+
+static int ce_ctr_crypt(uint8_t ctr[AES_BLOCK_SIZE], const uint8_t *in,
+			uint8_t *out, size_t len)
+{
+	uint8x16_t s[4];
+	uint8_t cb[4 * AES_BLOCK_SIZE];
+	uint8_t ks[AES_BLOCK_SIZE];
+	size_t n, i;
+
+	while (len) {
+		for (i = 0; i < 4; i++) {
+			memcpy(cb + AES_BLOCK_SIZE * i, ctr, AES_BLOCK_SIZE);
+			aes_ctr_add(ctr, 1);
+			s[i] = vld1q_u8(cb + AES_BLOCK_SIZE * i);
+		}
+		encrypt4(s);
+
+		for (i = 0; i < 4 && len >= AES_BLOCK_SIZE; i++) {
+			vst1q_u8(out, veorq_u8(s[i], vld1q_u8(in)));
+			in += AES_BLOCK_SIZE;
+			out += AES_BLOCK_SIZE;
+			len -= AES_BLOCK_SIZE;
+		}
+		if (i < 4) {
+			/* Give back the counter values that were not used */
+			memcpy(ctr, cb + AES_BLOCK_SIZE * i, AES_BLOCK_SIZE);
+			/* A partial last block does not advance the counter */
+			vst1q_u8(ks, s[i]);
+			for (n = 0; n < len; n++)
+				out[n] = in[n] ^ ks[n];
+			memset(ks, 0, sizeof(ks));
+			len = 0;
+		}
+	}
+	return 0;
+}
+
+const struct aes_backend aes_backend_ce = {
+	.name = "ce",
+	.probe = ce_probe,
+	.set_key = ce_set_key,
+	.release = ce_release,
+	.ecb_decrypt = ce_ecb_decrypt,
+	.ctr_crypt = ce_ctr_crypt,
+};
+
+#else
+
+static int ce_probe(void)
+{
+	return 0;
+}
+
+const struct aes_backend aes_backend_ce = {
+	.name = "ce",
+	.probe = ce_probe,
+};
+
+#endif
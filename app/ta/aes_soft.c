@@ -0,0 +1,497 @@
+/*
+ * Copyright (c) 2015, Linaro Limited
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Portable AES-128 without lookup tables
+ *
+ * Two blocks are processed at a time as eight 32-bit column words. For
+ * SubBytes the words are transposed into bit planes, so that one pass of
+ * the Boyar-Peralta S-box circuit substitutes all 32 bytes using only
+ * logic operations; ShiftRows and MixColumns work on the column words.
+ * Nothing is indexed by secret data, so timing does not depend on the key
+ * or the plaintext. The inverse S-box reuses the forward circuit between
+ * two affine transforms.
+ */
+
+#include <string.h>
+#include "aes_backend.h"
+
+static uint32_t rk[AES_ROUND_KEY_WORDS];
+
+static uint32_t get_le32(const uint8_t *p)
+{
+	return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static void put_le32(uint8_t *p, uint32_t v)
+{
+	p[0] = v;
+	p[1] = v >> 8;
+	p[2] = v >> 16;
+	p[3] = v >> 24;
+}
+
+static uint32_t ror32(uint32_t v, unsigned int n)
+{
+	return (v >> n) | (v << (32 - n));
+}
+
+#define SWAPN(cl, ch, s, x, y) do { \
+		uint32_t a = (x), b = (y); \
+		(x) = (a & (cl)) | ((b & (cl)) << (s)); \
+		(y) = ((a & (ch)) >> (s)) | (b & (ch)); \
+	} while (0)
+
+/*
+ * Transpose the 8x8 bit matrices formed by byte n of each word, so that
+ * q[k] holds bit k of every byte. Its own inverse.
+ */
+static void ortho(uint32_t q[8])
+{
+	SWAPN(0x55555555, 0xaaaaaaaa, 1, q[0], q[1]);
+	SWAPN(0x55555555, 0xaaaaaaaa, 1, q[2], q[3]);
+	SWAPN(0x55555555, 0xaaaaaaaa, 1, q[4], q[5]);
+	SWAPN(0x55555555, 0xaaaaaaaa, 1, q[6], q[7]);
+
+	SWAPN(0x33333333, 0xcccccccc, 2, q[0], q[2]);
+	SWAPN(0x33333333, 0xcccccccc, 2, q[1], q[3]);
+	SWAPN(0x33333333, 0xcccccccc, 2, q[4], q[6]);
+	SWAPN(0x33333333, 0xcccccccc, 2, q[5], q[7]);
+
+	SWAPN(0x0f0f0f0f, 0xf0f0f0f0, 4, q[0], q[4]);
+	SWAPN(0x0f0f0f0f, 0xf0f0f0f0, 4, q[1], q[5]);
+	SWAPN(0x0f0f0f0f, 0xf0f0f0f0, 4, q[2], q[6]);
+	SWAPN(0x0f0f0f0f, 0xf0f0f0f0, 4, q[3], q[7]);
+}
+
+/*
+ * S-box on 32 bytes in bit planes: the circuit from Boyar and Peralta, "A
+ * new combinational logic minimization technique with applications to
+ * cryptology". x0 is the most significant bit.
+ */
+static void sbox_planes(uint32_t q[8])
+{
+	uint32_t x0, x1, x2, x3, x4, x5, x6, x7;
+	uint32_t y1, y2, y3, y4, y5, y6, y7, y8, y9, y10, y11, y12, y13;
+	uint32_t y14, y15, y16, y17, y18, y19, y20, y21;
+	uint32_t z0, z1, z2, z3, z4, z5, z6, z7, z8, z9, z10, z11, z12;
+	uint32_t z13, z14, z15, z16, z17;
+	uint32_t t0, t1, t2, t3, t4, t5, t6, t7, t8, t9, t10, t11, t12;
+	uint32_t t13, t14, t15, t16, t17, t18, t19, t20, t21, t22, t23;
+	uint32_t t24, t25, t26, t27, t28, t29, t30, t31, t32, t33, t34;
+	uint32_t t35, t36, t37, t38, t39, t40, t41, t42, t43, t44, t45;
+	uint32_t t46, t47, t48, t49, t50, t51, t52, t53, t54, t55, t56;
+	uint32_t t57, t58, t59, t60, t61, t62, t63, t64, t65, t66, t67;
+	uint32_t s0, s1, s2, s3, s4, s5, s6, s7;
+
+	x0 = q[7];
+	x1 = q[6];
+	x2 = q[5];
+	x3 = q[4];
+	x4 = q[3];
+	x5 = q[2];
+	x6 = q[1];
+	x7 = q[0];
+
+	/* Top linear transformation */
+	y14 = x3 ^ x5;
+	y13 = x0 ^ x6;
+	y9 = x0 ^ x3;
+	y8 = x0 ^ x5;
+	t0 = x1 ^ x2;
+	y1 = t0 ^ x7;
+	y4 = y1 ^ x3;
+	y12 = y13 ^ y14;
+	y2 = y1 ^ x0;
+	y5 = y1 ^ x6;
+	y3 = y5 ^ y8;
+	t1 = x4 ^ y12;
+	y15 = t1 ^ x5;
+	y20 = t1 ^ x1;
+	y6 = y15 ^ x7;
+	y10 = y15 ^ t0;
+	y11 = y20 ^ y9;
+	y7 = x7 ^ y11;
+	y17 = y10 ^ y11;
+	y19 = y10 ^ y8;
+	y16 = t0 ^ y11;
+	y21 = y13 ^ y16;
+	y18 = x0 ^ y16;
+
+	/* Non-linear section: inversion in GF(2^4)^2 */
+	t2 = y12 & y15;
+	t3 = y3 & y6;
+	t4 = t3 ^ t2;
+	t5 = y4 & x7;
+	t6 = t5 ^ t2;
+	t7 = y13 & y16;
+	t8 = y5 & y1;
+	t9 = t8 ^ t7;
+	t10 = y2 & y7;
+	t11 = t10 ^ t7;
+	t12 = y9 & y11;
+	t13 = y14 & y17;
+	t14 = t13 ^ t12;
+	t15 = y8 & y10;
+	t16 = t15 ^ t12;
+	t17 = t4 ^ t14;
+	t18 = t6 ^ t16;
+	t19 = t9 ^ t14;
+	t20 = t11 ^ t16;
+	t21 = t17 ^ y20;
+	t22 = t18 ^ y19;
+	t23 = t19 ^ y21;
+	t24 = t20 ^ y18;
+
+	t25 = t21 ^ t22;
+	t26 = t21 & t23;
+	t27 = t24 ^ t26;
+	t28 = t25 & t27;
+	t29 = t28 ^ t22;
+	t30 = t23 ^ t24;
+	t31 = t22 ^ t26;
+	t32 = t31 & t30;
+	t33 = t32 ^ t24;
+	t34 = t23 ^ t33;
+	t35 = t27 ^ t33;
+	t36 = t24 & t35;
+	t37 = t36 ^ t34;
+	t38 = t27 ^ t36;
+	t39 = t29 & t38;
+	t40 = t25 ^ t39;
+
+	t41 = t40 ^ t37;
+	t42 = t29 ^ t33;
+	t43 = t29 ^ t40;
+	t44 = t33 ^ t37;
+	t45 = t42 ^ t41;
+	z0 = t44 & y15;
+	z1 = t37 & y6;
+	z2 = t33 & x7;
+	z3 = t43 & y16;
+	z4 = t40 & y1;
+	z5 = t29 & y7;
+	z6 = t42 & y11;
+	z7 = t45 & y17;
+	z8 = t41 & y10;
+	z9 = t44 & y12;
+	z10 = t37 & y3;
+	z11 = t33 & y4;
+	z12 = t43 & y13;
+	z13 = t40 & y5;
+	z14 = t29 & y2;
+	z15 = t42 & y9;
+	z16 = t45 & y14;
+	z17 = t41 & y8;
+
+	/* Bottom linear transformation */
+	t46 = z15 ^ z16;
+	t47 = z10 ^ z11;
+	t48 = z5 ^ z13;
+	t49 = z9 ^ z10;
+	t50 = z2 ^ z12;
+	t51 = z2 ^ z5;
+	t52 = z7 ^ z8;
+	t53 = z0 ^ z3;
+	t54 = z6 ^ z7;
+	t55 = z16 ^ z17;
+	t56 = z12 ^ t48;
+	t57 = t50 ^ t53;
+	t58 = z4 ^ t46;
+	t59 = z3 ^ t54;
+	t60 = t46 ^ t57;
+	t61 = z14 ^ t57;
+	t62 = t52 ^ t58;
+	t63 = t49 ^ t58;
+	t64 = z4 ^ t59;
+	t65 = t61 ^ t62;
+	t66 = z1 ^ t63;
+	s0 = t59 ^ t63;
+	s6 = t56 ^ ~t62;
+	s7 = t48 ^ ~t60;
+	t67 = t64 ^ t65;
+	s3 = t53 ^ t66;
+	s4 = t51 ^ t66;
+	s5 = t47 ^ t65;
+	s1 = t64 ^ ~s3;
+	s2 = t55 ^ ~t67;
+
+	q[7] = s0;
+	q[6] = s1;
+	q[5] = s2;
+	q[4] = s3;
+	q[3] = s4;
+	q[2] = s5;
+	q[1] = s6;
+	q[0] = s7;
+}
+
+/*
+ * S(x) = A(inv(x)) ^ 0x63, so inv_S(x) = B(S(B(x ^ 0x63)) ^ 0x63) where B
+ * is the inverse of the linear map A.
+ */
+static void inv_affine_planes(uint32_t q[8])
+{
+	uint32_t q0 = ~q[0], q1 = ~q[1], q2 = q[2], q3 = q[3];
+	uint32_t q4 = q[4], q5 = ~q[5], q6 = ~q[6], q7 = q[7];
+
+	q[7] = q1 ^ q4 ^ q6;
+	q[6] = q0 ^ q3 ^ q5;
+	q[5] = q7 ^ q2 ^ q4;
+	q[4] = q6 ^ q1 ^ q3;
+	q[3] = q5 ^ q0 ^ q2;
+	q[2] = q4 ^ q7 ^ q1;
+	q[1] = q3 ^ q6 ^ q0;
+	q[0] = q2 ^ q5 ^ q7;
+}
+
+static void sub_bytes(uint32_t q[8])
+{
+	ortho(q);
+	sbox_planes(q);
+	ortho(q);
+}
+
+static void inv_sub_bytes(uint32_t q[8])
+{
+	ortho(q);
+	inv_affine_planes(q);
+	sbox_planes(q);
+	inv_affine_planes(q);
+	ortho(q);
+}
+
+/* Row r of the block moves left by r columns, r is the byte in the word */
+static void shift_rows(uint32_t w[4])
+{
+	uint32_t a = w[0], b = w[1], c = w[2], d = w[3];
+
+	w[0] = (a & 0xff) | (b & 0xff00) | (c & 0xff0000) | (d & 0xff000000);
+	w[1] = (b & 0xff) | (c & 0xff00) | (d & 0xff0000) | (a & 0xff000000);
+	w[2] = (c & 0xff) | (d & 0xff00) | (a & 0xff0000) | (b & 0xff000000);
+	w[3] = (d & 0xff) | (a & 0xff00) | (b & 0xff0000) | (c & 0xff000000);
+}
+
+static void inv_shift_rows(uint32_t w[4])
+{
+	uint32_t a = w[0], b = w[1], c = w[2], d = w[3];
+
+	w[0] = (a & 0xff) | (d & 0xff00) | (c & 0xff0000) | (b & 0xff000000);
+	w[1] = (b & 0xff) | (a & 0xff00) | (d & 0xff0000) | (c & 0xff000000);
+	w[2] = (c & 0xff) | (b & 0xff00) | (a & 0xff0000) | (d & 0xff000000);
+	w[3] = (d & 0xff) | (c & 0xff00) | (b & 0xff0000) | (a & 0xff000000);
+}
+
+/* Multiply each byte by x in GF(2^8) */
+static uint32_t xtime4(uint32_t v)
+{
+	return ((v & 0x7f7f7f7f) << 1) ^ (((v >> 7) & 0x01010101) * 0x1b);
+}
+
+static uint32_t mix_column(uint32_t w)
+{
+	uint32_t r = ror32(w, 8);
+
+	return xtime4(w ^ r) ^ r ^ ror32(w, 16) ^ ror32(w, 24);
+}
+
+/* InvMixColumns is MixColumns after adding 4 * (a[i] ^ a[i + 2]) */
+static uint32_t inv_mix_column(uint32_t w)
+{
+	return mix_column(w ^ xtime4(xtime4(w ^ ror32(w, 16))));
+}
+
+static void add_round_key(uint32_t q[8], const uint32_t *k)
+{
+	int i;
+
+	for (i = 0; i < 4; i++) {
+		q[i] ^= k[i];
+		q[i + 4] ^= k[i];
+	}
+}
+
+static void load2(uint32_t q[8], const uint8_t *in)
+{
+	int i;
+
+	for (i = 0; i < 8; i++)
+		q[i] = get_le32(in + 4 * i);
+}
+
+static void store2(uint8_t *out, const uint32_t q[8])
+{
+	int i;
+
+	for (i = 0; i < 8; i++)
+		put_le32(out + 4 * i, q[i]);
+}
+
+static void encrypt2(uint32_t q[8])
+{
+	int r, i;
+
+	add_round_key(q, rk);
+	for (r = 1; r < 10; r++) {
+		sub_bytes(q);
+		shift_rows(q);
+		shift_rows(q + 4);
+		for (i = 0; i < 8; i++)
+			q[i] = mix_column(q[i]);
+		add_round_key(q, rk + 4 * r);
+	}
+	sub_bytes(q);
+	shift_rows(q);
+	shift_rows(q + 4);
+	add_round_key(q, rk + 40);
+}
+
+static void decrypt2(uint32_t q[8])
+{
+	int r, i;
+
+	add_round_key(q, rk + 40);
+	for (r = 9; r > 0; r--) {
+		inv_shift_rows(q);
+		inv_shift_rows(q + 4);
+		inv_sub_bytes(q);
+		add_round_key(q, rk + 4 * r);
+		for (i = 0; i < 8; i++)
+			q[i] = inv_mix_column(q[i]);
+	}
+	inv_shift_rows(q);
+	inv_shift_rows(q + 4);
+	inv_sub_bytes(q);
+	add_round_key(q, rk);
+}
+
+void aes_expand_key(const uint8_t key[AES_KEY_SIZE],
+		    uint32_t w[AES_ROUND_KEY_WORDS])
+{
+	uint32_t q[8] = { 0 };
+	uint32_t rcon = 1;
+	int i;
+
+	for (i = 0; i < 4; i++)
+		w[i] = get_le32(key + 4 * i);
+	for (i = 4; i < AES_ROUND_KEY_WORDS; i++) {
+		uint32_t t = w[i - 1];
+
+		if (!(i % 4)) {
+			/* RotWord and SubWord, one column through the S-box */
+			memset(q, 0, sizeof(q));
+			q[0] = ror32(t, 8);
+			sub_bytes(q);
+			t = q[0] ^ rcon;
+			rcon = xtime4(rcon);
+		}
+		w[i] = w[i - 4] ^ t;
+	}
+	memset(q, 0, sizeof(q));
+}
+
+static int soft_probe(void)
+{
+	return 1;
+}
+
+static int soft_set_key(const uint8_t key[AES_KEY_SIZE])
+{
+	aes_expand_key(key, rk);
+	return 0;
+}
+
+static void soft_release(void)
+{
+	memset(rk, 0, sizeof(rk));
+}
+
+static int soft_ecb_decrypt(const uint8_t *in, uint8_t *out, size_t len)
+{
+	uint32_t q[8];
+	uint8_t tmp[2 * AES_BLOCK_SIZE];
+
+	if (len % AES_BLOCK_SIZE)
+		return -1;
+
+	for (; len >= 2 * AES_BLOCK_SIZE; len -= 2 * AES_BLOCK_SIZE) {
+		load2(q, in);
+		decrypt2(q);
+		store2(out, q);
+		in += 2 * AES_BLOCK_SIZE;
+		out += 2 * AES_BLOCK_SIZE;
+	}
+	if (len) {
+		/* Odd block out, the second lane decrypts garbage */
+		memset(tmp, 0, sizeof(tmp));
+		memcpy(tmp, in, AES_BLOCK_SIZE);
+		load2(q, tmp);
+		decrypt2(q);
+		store2(tmp, q);
+		memcpy(out, tmp, AES_BLOCK_SIZE);
+		memset(tmp, 0, sizeof(tmp));
+	}
+	memset(q, 0, sizeof(q));
+	return 0;
+}
+
+static int soft_ctr_crypt(uint8_t ctr[AES_BLOCK_SIZE], const uint8_t *in,
+			  uint8_t *out, size_t len)
+{
+	uint32_t q[8];
+	uint8_t ks[2 * AES_BLOCK_SIZE];
+	size_t n, i;
+
+	while (len) {
+		memcpy(ks, ctr, AES_BLOCK_SIZE);
+		memcpy(ks + AES_BLOCK_SIZE, ctr, AES_BLOCK_SIZE);
+		aes_ctr_add(ks + AES_BLOCK_SIZE, 1);
+		load2(q, ks);
+		encrypt2(q);
+		store2(ks, q);
+
+		n = len < sizeof(ks) ? len : sizeof(ks);
+		for (i = 0; i < n; i++)
+			out[i] = in[i] ^ ks[i];
+		aes_ctr_add(ctr, n / AES_BLOCK_SIZE);
+		in += n;
+		out += n;
+		len -= n;
+	}
+	memset(q, 0, sizeof(q));
+	memset(ks, 0, sizeof(ks));
+	return 0;
+}
+
+const struct aes_backend aes_backend_soft = {
+	.name = "soft",
+	.probe = soft_probe,
+	.set_key = soft_set_key,
+	.release = soft_release,
+	.ecb_decrypt = soft_ecb_decrypt,
+	.ctr_crypt = soft_ctr_crypt,
+};
@@ -0,0 +1,151 @@
+/*
+ * Copyright (c) 2015, Linaro Limited
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * AES-128 through the cipher operations of the TEE Internal API. Each call
+ * is a system call into the TEE core, so small chunks are expensive.
+ */
+
+#include <tee_internal_api.h>
+#include <tee_internal_api_extensions.h>
+
+#include "aes_backend.h"
+
+#define STR_TRACE_USER_TA "SECVIDEO_DEMO"
+
+#define CHECK(res, name, action) do { \
+		if ((res) != TEE_SUCCESS) { \
+			DMSG(name ": 0x%08x", (res)); \
+			action \
+		} \
+	} while(0)
+
+static TEE_OperationHandle ecb_op = NULL;
+static TEE_OperationHandle ctr_op = NULL;
+
+static TEE_Result alloc_aes_op(TEE_OperationHandle *op, uint32_t algo,
+			       const uint8_t *key)
+{
+	TEE_Result res;
+	TEE_ObjectHandle hkey;
+	TEE_Attribute attr;
+
+	DMSG("TEE_AllocateOperation");
+	res = TEE_AllocateOperation(op, algo, TEE_MODE_DECRYPT, 128);
+	CHECK(res, "TEE_AllocateOperation", return res;);
+
+	DMSG("TEE_AllocateTransientObject");
+	res = TEE_AllocateTransientObject(TEE_TYPE_AES, 128, &hkey);
+	CHECK(res, "TEE_AllocateTransientObject", goto free_op;);
+
+	attr.attributeID = TEE_ATTR_SECRET_VALUE;
+	attr.content.ref.buffer = (void *)key;
+	attr.content.ref.length = AES_KEY_SIZE;
+
+	DMSG("TEE_PopulateTransientObject");
+	res = TEE_PopulateTransientObject(hkey, &attr, 1);
+	CHECK(res, "TEE_PopulateTransientObject", goto free_key;);
+
+	DMSG("TEE_SetOperationKey");
+	res = TEE_SetOperationKey(*op, hkey);
+	CHECK(res, "TEE_SetOperationKey", goto free_key;);
+
+	TEE_FreeTransientObject(hkey);
+	return TEE_SUCCESS;
+
+free_key:
+	TEE_FreeTransientObject(hkey);
+free_op:
+	TEE_FreeOperation(*op);
+	*op = NULL;
+	return res;
+}
+
+static int tee_probe(void)
+{
+	return 1;
+}
+
+static void tee_release(void)
+{
+	if (ecb_op)
+		TEE_FreeOperation(ecb_op);
+	ecb_op = NULL;
+	if (ctr_op)
+		TEE_FreeOperation(ctr_op);
+	ctr_op = NULL;
+}
+
+static int tee_set_key(const uint8_t key[AES_KEY_SIZE])
+{
+	TEE_Result res;
+
+	tee_release();
+	res = alloc_aes_op(&ecb_op, TEE_ALG_AES_ECB_NOPAD, key);
+	if (res == TEE_SUCCESS)
+		res = alloc_aes_op(&ctr_op, TEE_ALG_AES_CTR, key);
+	if (res != TEE_SUCCESS) {
+		tee_release();
+		return -1;
+	}
+	return 0;
+}
+
+static int tee_crypt(TEE_OperationHandle op, uint8_t *iv, const uint8_t *in,
+		     uint8_t *out, size_t len)
+{
+	TEE_Result res;
+	size_t outsz = len;
+
+	TEE_CipherInit(op, iv, iv ? AES_BLOCK_SIZE : 0);
+	res = TEE_CipherDoFinal(op, (void *)in, len, out, &outsz);
+	CHECK(res, "TEE_CipherDoFinal", return -1;);
+	return outsz == len ? 0 : -1;
+}
+
+static int tee_ecb_decrypt(const uint8_t *in, uint8_t *out, size_t len)
+{
+	return tee_crypt(ecb_op, NULL, in, out, len);
+}
+
+static int tee_ctr_crypt(uint8_t ctr[AES_BLOCK_SIZE], const uint8_t *in,
+			 uint8_t *out, size_t len)
+{
+	if (tee_crypt(ctr_op, ctr, in, out, len))
+		return -1;
+	aes_ctr_add(ctr, len / AES_BLOCK_SIZE);
+	return 0;
+}
+
+const struct aes_backend aes_backend_tee = {
+	.name = "tee",
+	.probe = tee_probe,
+	.set_key = tee_set_key,
+	.release = tee_release,
+	.ecb_decrypt = tee_ecb_decrypt,
+	.ctr_crypt = tee_ctr_crypt,
+};
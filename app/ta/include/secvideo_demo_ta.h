@@ -41,13 +41,77 @@ enum {
 	 * - params[0].memref points to shared memory containing image data
 	 * - params[1].value.a is the offset into the target framebuffer
 	 * - params[1].value.b contains flags (IMAGE_START, etc.)
+	 * When IMAGE_SCALE is set, params[1].value.a is the offset into the
+	 * source image instead, and the data goes through the scaler.
+	 * When IMAGE_CTR is set, params[3].memref holds the 16-byte AES-CTR
+	 * counter block for the first byte of params[0].
 	 */
 	TA_SECVIDEO_DEMO_IMAGE_DATA,
+	/*
+	 * Configure the scaler used by IMAGE_DATA when IMAGE_SCALE is set
+	 * - params[0].value.a = source width | source height << 16
+	 * - params[0].value.b = filter (SCALE_FILTER_NEAREST, etc.)
+	 * - params[1].value.a = destination x | destination y << 16
+	 * - params[1].value.b = destination width | destination height << 16
+	 */
+	TA_SECVIDEO_DEMO_SET_SCALER,
+	/*
+	 * Report the TA memory footprint
+	 * - params[0].value.a/b = heap in use now/max sampled heap use, of the
+	 *   samples taken at session open and on this command only (estimated
+	 *   from the largest free block)
+	 * - params[1].value.a/b = peak stack use/deepest measurable use, below
+	 *   the entry code of TA_CreateEntryPoint()
+	 * - params[2].value.a/b = scaler arena peak use/size
+	 */
+	TA_SECVIDEO_DEMO_GET_MEM_STATS,
+	/*
+	 * Draw a test pattern into the whole framebuffer
+	 * - params[0].value.a = pattern (PATTERN_COLOR_BARS, etc.)
+	 * - params[0].value.b = frame number (animates PATTERN_MOVING_BOX)
+	 * - params[1].memref is the framebuffer
+	 */
+	TA_SECVIDEO_DEMO_PATTERN,
+	/*
+	 * Compute a digest of a framebuffer rectangle: HMAC-SHA256, keyed by
+	 * the TA, of the geometry then the rows. x and y are multiples of
+	 * CHECKSUM_TILE, and so are width and height unless the rectangle
+	 * ends at the right or bottom edge of the framebuffer: no area smaller
+	 * than a tile can be guessed from its digest, and a full frame can
+	 * still be checked.
+	 * - params[0].value.a = x | y << 16
+	 * - params[0].value.b = width | height << 16
+	 * - params[1].memref is the framebuffer
+	 * - params[2].memref receives the CHECKSUM_SIZE byte digest
+	 * Returns TEE_ERROR_NOT_SUPPORTED if the TEE has no HMAC-SHA256.
+	 */
+	TA_SECVIDEO_DEMO_CHECKSUM_RECT,
 };
 
+/* CHECKSUM_RECT granularity, in pixels, and digest size */
+#define CHECKSUM_TILE	16
+#define CHECKSUM_SIZE	32
+
 /* Image data flags */
 #define IMAGE_START	1
 #define IMAGE_END	2
 #define IMAGE_ENCRYPTED	4
+#define IMAGE_SCALE	8
+#define IMAGE_CTR	16	/* With IMAGE_ENCRYPTED: AES-CTR, not AES-ECB */
+
+/* Scaler filters */
+#define SCALE_FILTER_NEAREST	0
+#define SCALE_FILTER_BILINEAR	1
+
+/* Test patterns */
+#define PATTERN_COLOR_BARS	0
+#define PATTERN_GRADIENT	1
+#define PATTERN_CHECKERBOARD	2
+#define PATTERN_MOVING_BOX	3	/* With the frame number in the box */
+
+/* Framebuffer geometry (32-bit pixels) */
+#define FB_WIDTH	800
+#define FB_HEIGHT	600
+#define FB_BPP		4
 
 #endif /* SECVIDEO_DEMO_TA_H */
@@ -0,0 +1,127 @@
+/*
+ * Copyright (c) 2015, Linaro Limited
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <tee_internal_api.h>
+#include <user_ta_header_defines.h>
+#include "mem_stats.h"
+
+#define STACK_PAINT		0xa5a5a5a5
+/*
+ * The TA runtime does not export the bounds of the stack, so they are taken
+ * from the frame of mem_stats_init(), called at the start of
+ * TA_CreateEntryPoint(). The entry code above it is assumed to use at most
+ * STACK_ENTRY_RESERVE bytes, and only the rest of TA_STACK_SIZE below that
+ * frame is painted.
+ */
+#define STACK_ENTRY_RESERVE	512
+#define STACK_PAINT_MAX		(TA_STACK_SIZE - STACK_ENTRY_RESERVE)
+#if STACK_PAINT_MAX <= 0
+#error "TA_STACK_SIZE is too small for stack painting"
+#endif
+/* Not painted, to stay clear of the frame of mem_stats_paint_stack() */
+#define STACK_GUARD		64
+
+static uintptr_t stack_ref;
+static uintptr_t paint_lo, paint_hi;
+static size_t heap_max;
+
+void __attribute__((noinline)) mem_stats_init(void)
+{
+	stack_ref = (uintptr_t)__builtin_frame_address(0);
+}
+
+void __attribute__((noinline)) mem_stats_paint_stack(void)
+{
+	uintptr_t fp = (uintptr_t)__builtin_frame_address(0);
+	uintptr_t lo, hi;
+	volatile uint32_t *p;
+
+	/* Entry points run at about the same depth, on the same stack */
+	if (!stack_ref || fp > stack_ref + STACK_ENTRY_RESERVE ||
+	    fp < stack_ref - STACK_PAINT_MAX)
+		return;
+
+	lo = (stack_ref - STACK_PAINT_MAX + 3) & ~(uintptr_t)3;
+	hi = ((fp < stack_ref ? fp : stack_ref) - STACK_GUARD) &
+	     ~(uintptr_t)3;
+	paint_lo = lo;
+	paint_hi = hi > lo ? hi : lo;
+	for (p = (uint32_t *)paint_lo; p < (uint32_t *)paint_hi; p++)
+		*p = STACK_PAINT;
+}
+
+size_t mem_stats_stack_peak(void)
+{
+	const volatile uint32_t *p;
+
+	if (!paint_lo)
+		return 0;
+	for (p = (uint32_t *)paint_lo; p < (uint32_t *)paint_hi; p++)
+		if (*p != STACK_PAINT)
+			break;
+	return stack_ref - (uintptr_t)p;
+}
+
+size_t mem_stats_stack_window(void)
+{
+	if (!paint_lo)
+		return 0;
+	return stack_ref - paint_lo;
+}
+
+/* Largest block TEE_Malloc() can currently return */
+static size_t heap_largest_free(void)
+{
+	size_t lo = 0, hi = TA_DATA_SIZE, mid;
+	void *p;
+
+	while (lo < hi) {
+		mid = (lo + hi + 1) / 2;
+		p = TEE_Malloc(mid, 0);
+		if (p) {
+			TEE_Free(p);
+			lo = mid;
+		} else {
+			hi = mid - 1;
+		}
+	}
+	return lo;
+}
+
+size_t mem_stats_sample_heap(void)
+{
+	size_t used = TA_DATA_SIZE - heap_largest_free();
+
+	if (used > heap_max)
+		heap_max = used;
+	return used;
+}
+
+size_t mem_stats_heap_max_sampled(void)
+{
+	return heap_max;
+}
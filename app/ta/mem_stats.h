@@ -0,0 +1,61 @@
+/*
+ * Copyright (c) 2015, Linaro Limited
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef MEM_STATS_H
+#define MEM_STATS_H
+
+#include <stddef.h>
+
+/*
+ * TA memory footprint measurements
+ *
+ * Heap use is derived from the largest block the allocator can still
+ * return, sampled with mem_stats_sample_heap(). Transient use between
+ * samples is not seen.
+ *
+ * Stack use is measured from the frame of mem_stats_init(), so the entry
+ * code above it is not counted. The stack below that frame, down to
+ * TA_STACK_SIZE minus a reserve for the entry code, and above the caller of
+ * mem_stats_paint_stack() is painted, and the deepest overwritten word
+ * gives the peak. Usage that never goes below the painted window is
+ * reported as the depth of its top.
+ */
+
+/* Call first thing in TA_CreateEntryPoint() */
+void mem_stats_init(void);
+/* Call from an entry point, at about the same depth as mem_stats_init() */
+void mem_stats_paint_stack(void);
+/* Stack used since it was painted, below the frame of mem_stats_init() */
+size_t mem_stats_stack_peak(void);
+/* Deepest stack use that can be measured */
+size_t mem_stats_stack_window(void);
+
+/* Returns the heap currently in use, and updates the maximum */
+size_t mem_stats_sample_heap(void);
+/* Max sampled heap use: transient use between samples is not included */
+size_t mem_stats_heap_max_sampled(void);
+
+#endif /* MEM_STATS_H */
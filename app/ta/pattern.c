@@ -0,0 +1,224 @@
+/*
+ * Copyright (c) 2015, Linaro Limited
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Test patterns, generated in the secure world to measure framebuffer fill
+ * rate without any data coming from normal world. Rows that repeat are
+ * generated once and copied, so that the cost is dominated by framebuffer
+ * writes.
+ */
+
+#include <tee_internal_api.h>
+#include <string.h>
+
+#include <secvideo_demo_ta.h>
+#include "pattern.h"
+
+/* Pixels are R, G, B, A bytes in memory */
+#define RGB(r, g, b)	((uint32_t)(r) | (uint32_t)(g) << 8 | \
+			 (uint32_t)(b) << 16 | 0xff000000)
+
+#define ROW_SZ		(FB_WIDTH * FB_BPP)
+
+#define CHECKER_SIZE	32
+
+#define BOX_W		160
+#define BOX_H		120
+#define BOX_BG		RGB(0x20, 0x20, 0x20)
+#define BOX_FG		RGB(0xff, 0xff, 0xff)
+#define BOX_TEXT	RGB(0x00, 0x00, 0x00)
+#define DIGITS		6
+#define DIGIT_SCALE	5	/* Screen pixels per font pixel */
+#define DIGIT_ADVANCE	(4 * DIGIT_SCALE)
+
+/* 3x5 font, one octal digit per row, top row first */
+static const uint16_t digit_font[10] = {
+	075557, 026227, 071747, 071717, 055711,
+	074717, 074757, 071111, 075757, 075717,
+};
+
+/* fb is word aligned, checked by pattern_draw() */
+static uint32_t *fb_row(void *fb, uint32_t y)
+{
+	return (uint32_t *)(void *)((uint8_t *)fb + y * ROW_SZ);
+}
+
+/* Copy row 'src' to rows [y0, y1) */
+static void repeat_row(void *fb, uint32_t src, uint32_t y0, uint32_t y1)
+{
+	uint32_t y;
+
+	for (y = y0; y < y1; y++)
+		memcpy(fb_row(fb, y), fb_row(fb, src), ROW_SZ);
+}
+
+static void fill_rect(void *fb, uint32_t x, uint32_t y, uint32_t w,
+		      uint32_t h, uint32_t color)
+{
+	uint32_t *row;
+	uint32_t i, j;
+
+	for (j = y; j < y + h; j++) {
+		row = fb_row(fb, j);
+		for (i = x; i < x + w; i++)
+			row[i] = color;
+	}
+}
+
+static void color_bars(void *fb)
+{
+	static const uint32_t bars[] = {
+		RGB(0xff, 0xff, 0xff), RGB(0xff, 0xff, 0x00),
+		RGB(0x00, 0xff, 0xff), RGB(0x00, 0xff, 0x00),
+		RGB(0xff, 0x00, 0xff), RGB(0xff, 0x00, 0x00),
+		RGB(0x00, 0x00, 0xff), RGB(0x00, 0x00, 0x00),
+	};
+	uint32_t *row = fb_row(fb, 0);
+	uint32_t x;
+
+	for (x = 0; x < FB_WIDTH; x++)
+		row[x] = bars[x * 8 / FB_WIDTH];
+	repeat_row(fb, 0, 1, FB_HEIGHT);
+}
+
+/*
+ * Red increases to the right, green downwards, blue along the diagonal.
+ * The divisions are stepped incrementally, so the inner loop is adds and
+ * stores.
+ */
+static void gradient(void *fb)
+{
+	const uint32_t dr = FB_WIDTH - 1, db = FB_WIDTH + FB_HEIGHT - 2;
+	uint32_t *row;
+	uint32_t x, y, g, r, r_rem, b, b_rem;
+
+	for (y = 0; y < FB_HEIGHT; y++) {
+		row = fb_row(fb, y);
+		g = y * 255 / (FB_HEIGHT - 1);
+		r = 0;
+		r_rem = 0;
+		b = y * 255 / db;
+		b_rem = y * 255 % db;
+		for (x = 0; x < FB_WIDTH; x++) {
+			row[x] = RGB(r, g, b);
+			/* 255 < dr and db: at most one step per pixel */
+			r_rem += 255;
+			if (r_rem >= dr) {
+				r_rem -= dr;
+				r++;
+			}
+			b_rem += 255;
+			if (b_rem >= db) {
+				b_rem -= db;
+				b++;
+			}
+		}
+	}
+}
+
+static void checkerboard(void *fb)
+{
+	uint32_t *row0 = fb_row(fb, 0);
+	uint32_t *row1 = fb_row(fb, CHECKER_SIZE);
+	uint32_t x, y, on;
+
+	for (x = 0; x < FB_WIDTH; x++) {
+		on = (x / CHECKER_SIZE) & 1;
+		row0[x] = on ? RGB(0xff, 0xff, 0xff) : RGB(0, 0, 0);
+		row1[x] = on ? RGB(0, 0, 0) : RGB(0xff, 0xff, 0xff);
+	}
+	for (y = 1; y < FB_HEIGHT; y++)
+		if (y != CHECKER_SIZE)
+			memcpy(fb_row(fb, y),
+			       (y / CHECKER_SIZE) & 1 ? row1 : row0, ROW_SZ);
+}
+
+/* Position in [0, range] going back and forth */
+static uint32_t bounce(uint32_t pos, uint32_t range)
+{
+	pos %= 2 * range;
+	return pos <= range ? pos : 2 * range - pos;
+}
+
+static void draw_digit(void *fb, uint32_t x, uint32_t y, unsigned int d)
+{
+	uint32_t r, c;
+
+	for (r = 0; r < 5; r++)
+		for (c = 0; c < 3; c++)
+			if (digit_font[d] & 1 << ((4 - r) * 3 + (2 - c)))
+				fill_rect(fb, x + c * DIGIT_SCALE,
+					  y + r * DIGIT_SCALE, DIGIT_SCALE,
+					  DIGIT_SCALE, BOX_TEXT);
+}
+
+/*
+ * The whole frame is redrawn every time, so that tearing shows up as a
+ * broken box edge.
+ */
+static void moving_box(void *fb, uint32_t frame)
+{
+	uint32_t bx = bounce(frame * 4, FB_WIDTH - BOX_W);
+	uint32_t by = bounce(frame * 3, FB_HEIGHT - BOX_H);
+	uint32_t tx = bx + (BOX_W - DIGITS * DIGIT_ADVANCE + DIGIT_SCALE) / 2;
+	uint32_t ty = by + (BOX_H - 5 * DIGIT_SCALE) / 2;
+	uint32_t n = frame;
+	int i;
+
+	fill_rect(fb, 0, 0, FB_WIDTH, 1, BOX_BG);
+	repeat_row(fb, 0, 1, FB_HEIGHT);
+	fill_rect(fb, bx, by, BOX_W, BOX_H, BOX_FG);
+	for (i = DIGITS - 1; i >= 0; i--) {
+		draw_digit(fb, tx + i * DIGIT_ADVANCE, ty, n % 10);
+		n /= 10;
+	}
+}
+
+TEE_Result pattern_draw(uint32_t pattern, uint32_t frame, void *fb,
+			size_t fb_sz)
+{
+	if (fb_sz < (size_t)ROW_SZ * FB_HEIGHT || ((uintptr_t)fb & 3))
+		return TEE_ERROR_SHORT_BUFFER;
+
+	switch (pattern) {
+	case PATTERN_COLOR_BARS:
+		color_bars(fb);
+		break;
+	case PATTERN_GRADIENT:
+		gradient(fb);
+		break;
+	case PATTERN_CHECKERBOARD:
+		checkerboard(fb);
+		break;
+	case PATTERN_MOVING_BOX:
+		moving_box(fb, frame);
+		break;
+	default:
+		return TEE_ERROR_BAD_PARAMETERS;
+	}
+	return TEE_SUCCESS;
+}
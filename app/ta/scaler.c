@@ -0,0 +1,297 @@
+/*
+ * Copyright (c) 2015, Linaro Limited
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Separable, row-streamed image scaler
+ *
+ * Source rows are consumed in order as they arrive from normal world. Each
+ * row that is sampled by the output is first scaled horizontally into one of
+ * two row buffers (indexed by the parity of the source row), then every
+ * destination row that only depends on rows seen so far is produced by
+ * blending those two buffers vertically, straight into the output buffer,
+ * or into a third row buffer handed to TEEExt_UpdateFrameBuffer() for
+ * plaintext. Memory use is therefore one source row plus three destination
+ * rows, whatever the image height.
+ */
+
+#include <tee_internal_api.h>
+#include <tee_internal_api_extensions.h>
+#include <string.h>
+
+#include <secvideo_demo_ta.h>
+#include "scaler.h"
+
+#define STR_TRACE_USER_TA "SECVIDEO_DEMO"
+
+#define MIN(a, b) ((a) < (b) ? (a) : (b))
+
+/*
+ * Source coordinates are computed in 16.16 fixed point with pixel centers
+ * aligned. A map entry holds the source index and the 8-bit weight of the
+ * next source pixel (always 0 with the nearest filter).
+ */
+#define MAP_IDX(m)	((m) >> 8)
+#define MAP_W(m)	((m) & 0xff)
+
+static uint8_t scaler_mem[SCALER_ARENA_SIZE] __attribute__((aligned(8)));
+static struct arena arena = ARENA_INIT(scaler_mem);
+
+static struct scaler {
+	uint32_t src_w, src_h;
+	uint32_t filter;
+	uint32_t dst_x, dst_y, dst_w, dst_h;
+	uint32_t step_y;	/* Source rows per destination row (16.16) */
+	uint32_t *xmap;		/* One map entry per destination column */
+	uint32_t *row;		/* Source row being assembled */
+	uint32_t *hrow[2];	/* Horizontally scaled rows */
+	uint32_t *out;		/* Destination row, without an output buffer */
+	size_t row_fill;	/* Bytes currently in row */
+	size_t consumed;	/* Source bytes received since scaler_start() */
+	uint32_t sy;		/* Index of the current source row */
+	uint32_t dy;		/* Next destination row to write */
+	uint32_t dy_map;	/* Map entry of destination row dy */
+} sc;
+
+static uint32_t map_coord(uint32_t d, uint32_t step, uint32_t src,
+			  uint32_t filter)
+{
+	int32_t pos = step / 2 + d * step;
+
+	if (filter == SCALE_FILTER_NEAREST)
+		return MIN((uint32_t)pos >> 16, src - 1) << 8;
+
+	pos -= 0x8000;
+	if (pos < 0)
+		pos = 0;
+	if ((uint32_t)pos >= (src - 1) << 16)
+		return (src - 1) << 8;
+	return ((uint32_t)pos >> 16) << 8 | (((uint32_t)pos >> 8) & 0xff);
+}
+
+/* Blend two pixels, two 8-bit channels at a time */
+static inline uint32_t lerp(uint32_t a, uint32_t b, uint32_t w)
+{
+	uint32_t rb, ag;
+
+	rb = ((a & 0xff00ff) * (256 - w) + (b & 0xff00ff) * w) >> 8;
+	ag = ((a >> 8) & 0xff00ff) * (256 - w) + ((b >> 8) & 0xff00ff) * w;
+	return (rb & 0xff00ff) | (ag & 0xff00ff00);
+}
+
+static void hscale(const uint32_t *src, uint32_t *dst)
+{
+	uint32_t i, m;
+
+	if (sc.filter == SCALE_FILTER_NEAREST) {
+		for (i = 0; i < sc.dst_w; i++)
+			dst[i] = src[MAP_IDX(sc.xmap[i])];
+		return;
+	}
+
+	for (i = 0; i < sc.dst_w; i++) {
+		m = sc.xmap[i];
+		if (MAP_W(m))
+			dst[i] = lerp(src[MAP_IDX(m)], src[MAP_IDX(m) + 1],
+				      MAP_W(m));
+		else
+			dst[i] = src[MAP_IDX(m)];
+	}
+}
+
+static TEE_Result emit_row(void *fb, size_t fb_sz)
+{
+	uint32_t y0 = MAP_IDX(sc.dy_map);
+	uint32_t w = MAP_W(sc.dy_map);
+	uint32_t *h0 = sc.hrow[y0 & 1];
+	const uint32_t *h1 = sc.hrow[(y0 + 1) & 1];
+	size_t off = ((size_t)(sc.dst_y + sc.dy) * FB_WIDTH + sc.dst_x) *
+		     FB_BPP;
+	size_t row_sz = sc.dst_w * FB_BPP;
+	uint32_t *out;
+	uint32_t i;
+
+	if (!fb) {
+		/* Plaintext, through the same path as unscaled image data */
+		if (!w)
+			return TEEExt_UpdateFrameBuffer(h0, row_sz, off, NULL);
+		for (i = 0; i < sc.dst_w; i++)
+			sc.out[i] = lerp(h0[i], h1[i], w);
+		return TEEExt_UpdateFrameBuffer(sc.out, row_sz, off, NULL);
+	}
+
+	if (off + row_sz > fb_sz)
+		return TEE_ERROR_SHORT_BUFFER;
+	/* fb is word aligned (checked by scaler_push()), off is whole pixels */
+	out = (uint32_t *)(void *)((uint8_t *)fb + off);
+
+	if (!w) {
+		memcpy(out, h0, row_sz);
+		return TEE_SUCCESS;
+	}
+	for (i = 0; i < sc.dst_w; i++)
+		out[i] = lerp(h0[i], h1[i], w);
+	return TEE_SUCCESS;
+}
+
+/* A complete source row is available in src */
+static TEE_Result row_done(const uint32_t *src, void *fb, size_t fb_sz)
+{
+	TEE_Result res;
+
+	/* Rows above the next sampled one are never used */
+	if (sc.dy >= sc.dst_h || sc.sy < MAP_IDX(sc.dy_map))
+		return TEE_SUCCESS;
+
+	hscale(src, sc.hrow[sc.sy & 1]);
+
+	while (sc.dy < sc.dst_h) {
+		if (MAP_IDX(sc.dy_map) + !!MAP_W(sc.dy_map) > sc.sy)
+			break;
+		res = emit_row(fb, fb_sz);
+		if (res != TEE_SUCCESS)
+			return res;
+		sc.dy++;
+		sc.dy_map = map_coord(sc.dy, sc.step_y, sc.src_h, sc.filter);
+	}
+	return TEE_SUCCESS;
+}
+
+TEE_Result scaler_setup(uint32_t src_w, uint32_t src_h, uint32_t filter,
+			uint32_t dst_x, uint32_t dst_y, uint32_t dst_w,
+			uint32_t dst_h)
+{
+	uint32_t i, step_x;
+
+	scaler_release();
+
+	if (!src_w || !src_h || !dst_w || !dst_h ||
+	    src_w > SCALER_MAX_SRC_WIDTH || src_h > SCALER_MAX_SRC_HEIGHT ||
+	    dst_x + dst_w > FB_WIDTH || dst_y + dst_h > FB_HEIGHT ||
+	    filter > SCALE_FILTER_BILINEAR)
+		return TEE_ERROR_BAD_PARAMETERS;
+
+	sc.xmap = arena_alloc(&arena, dst_w * sizeof(uint32_t));
+	sc.row = arena_alloc(&arena, src_w * sizeof(uint32_t));
+	sc.hrow[0] = arena_alloc(&arena, dst_w * sizeof(uint32_t));
+	sc.hrow[1] = arena_alloc(&arena, dst_w * sizeof(uint32_t));
+	sc.out = arena_alloc(&arena, dst_w * sizeof(uint32_t));
+	if (!sc.xmap || !sc.row || !sc.hrow[0] || !sc.hrow[1] || !sc.out) {
+		scaler_release();
+		return TEE_ERROR_OUT_OF_MEMORY;
+	}
+
+	sc.src_w = src_w;
+	sc.src_h = src_h;
+	sc.filter = filter;
+	sc.dst_x = dst_x;
+	sc.dst_y = dst_y;
+	sc.dst_w = dst_w;
+	sc.dst_h = dst_h;
+	sc.step_y = (src_h << 16) / dst_h;
+	step_x = (src_w << 16) / dst_w;
+	for (i = 0; i < dst_w; i++)
+		sc.xmap[i] = map_coord(i, step_x, src_w, filter);
+
+	scaler_start();
+	return TEE_SUCCESS;
+}
+
+void scaler_start(void)
+{
+	sc.row_fill = 0;
+	sc.consumed = 0;
+	sc.sy = 0;
+	sc.dy = 0;
+	if (sc.row)
+		sc.dy_map = map_coord(0, sc.step_y, sc.src_h, sc.filter);
+}
+
+TEE_Result scaler_push(const void *data, size_t sz, void *fb, size_t fb_sz)
+{
+	const uint8_t *p = data;
+	size_t row_sz = sc.src_w * FB_BPP;
+	const uint32_t *src;
+	TEE_Result res;
+	size_t n;
+
+	if (!sc.row)
+		return TEE_ERROR_BAD_STATE;
+	if ((uintptr_t)fb & 3)
+		return TEE_ERROR_BAD_PARAMETERS;
+
+	while (sz > 0) {
+		if (sc.sy >= sc.src_h)
+			return TEE_ERROR_BAD_PARAMETERS;
+
+		src = NULL;
+		if (!sc.row_fill && sz >= row_sz && !((uintptr_t)p & 3)) {
+			/* Whole aligned row in the input: use it in place */
+			src = (const uint32_t *)(const void *)p;
+			n = row_sz;
+		} else {
+			n = MIN(sz, row_sz - sc.row_fill);
+			memcpy((uint8_t *)sc.row + sc.row_fill, p, n);
+			sc.row_fill += n;
+			if (sc.row_fill == row_sz) {
+				src = sc.row;
+				sc.row_fill = 0;
+			}
+		}
+		p += n;
+		sz -= n;
+		sc.consumed += n;
+
+		if (src) {
+			res = row_done(src, fb, fb_sz);
+			if (res != TEE_SUCCESS)
+				return res;
+			sc.sy++;
+		}
+	}
+	return TEE_SUCCESS;
+}
+
+size_t scaler_consumed(void)
+{
+	return sc.consumed;
+}
+
+int scaler_done(void)
+{
+	return sc.row && sc.dy >= sc.dst_h;
+}
+
+void scaler_release(void)
+{
+	arena_reset(&arena);
+	memset(&sc, 0, sizeof(sc));
+}
+
+const struct arena *scaler_arena(void)
+{
+	return &arena;
+}
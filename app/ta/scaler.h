@@ -0,0 +1,63 @@
+/*
+ * Copyright (c) 2015, Linaro Limited
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef SCALER_H
+#define SCALER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <tee_internal_api.h>
+#include <secvideo_demo_ta.h>
+#include "arena.h"
+
+/*
+ * Only one source row (plus two horizontally scaled rows) is held at a time,
+ * so the source width is bounded by the scaler arena, not by the image size.
+ */
+#define SCALER_MAX_SRC_WIDTH	1920
+#define SCALER_MAX_SRC_HEIGHT	4096
+
+/* Source row, three destination rows and the column map, plus alignment */
+#define SCALER_ARENA_SIZE \
+	((SCALER_MAX_SRC_WIDTH + 4 * FB_WIDTH) * sizeof(uint32_t) + 5 * 8)
+
+TEE_Result scaler_setup(uint32_t src_w, uint32_t src_h, uint32_t filter,
+			uint32_t dst_x, uint32_t dst_y, uint32_t dst_w,
+			uint32_t dst_h);
+void scaler_start(void);
+/*
+ * Feed plaintext source pixels, in order. Output goes to fb, or through
+ * TEEExt_UpdateFrameBuffer() when fb is NULL.
+ */
+TEE_Result scaler_push(const void *data, size_t sz, void *fb, size_t fb_sz);
+/* Number of source bytes consumed since scaler_start() */
+size_t scaler_consumed(void);
+/* True when all destination rows have been written */
+int scaler_done(void);
+void scaler_release(void);
+const struct arena *scaler_arena(void);
+
+#endif /* SCALER_H */
@@ -11,24 +11,141 @@
 #include <string.h>
 
 #include <secvideo_demo_ta.h>
+#include "scaler.h"
+#include "mem_stats.h"
+#include "pattern.h"
+#include "aes_backend.h"
 
 #define STR_TRACE_USER_TA "SECVIDEO_DEMO"
 
 #define MIN(a, b) ((a) < (b) ? (a) : (b))
 
-#define CHECK(res, name, action) do { \
-		if ((res) != TEE_SUCCESS) { \
-			DMSG(name ": 0x%08x", (res)); \
-			action \
-		} \
-	} while(0)
-
 /* In a real world application, the secret key would be in secure storage */
 static uint8_t aes_key[] =
 	{ 0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07,
 	  0x08, 0x09, 0x0A, 0x0B, 0x0C, 0x0D, 0x0E, 0x0F };
 
-static TEE_OperationHandle crypto_op = NULL;
+/*
+ * Tried in order, the first one that is built in and accepts the key is
+ * used. CFG_AES_BACKEND restricts the choice to the backend of that name.
+ */
+static const struct aes_backend *const aes_backends[] = {
+	&aes_backend_ce,
+	&aes_backend_tee,
+	&aes_backend_soft,
+};
+
+static const struct aes_backend *aes;
+
+/*
+ * CHECKSUM_RECT key. Like aes_key, it would be in secure storage in a real
+ * world application. It is fixed so that digests can be compared across
+ * runs.
+ */
+static const uint8_t mac_key[] =
+	{ 0x73, 0x65, 0x63, 0x76, 0x69, 0x64, 0x65, 0x6f,
+	  0x2d, 0x63, 0x68, 0x65, 0x63, 0x6b, 0x73, 0x75,
+	  0x6d, 0x2d, 0x72, 0x65, 0x63, 0x74, 0x2d, 0x6b,
+	  0x65, 0x79, 0x2d, 0x32, 0x30, 0x31, 0x35, 0x00 };
+
+static TEE_OperationHandle mac_op = NULL;
+
+static unsigned int session_count;
+
+/*
+ * Working buffers of the frame path. They are static so that no command
+ * needs the heap once the session is open.
+ */
+static uint8_t scale_buf[2048];	/* Decrypted data on its way to the scaler */
+static uint8_t clear_buf[4096];	/* Solid color for CLEAR_SCREEN */
+
+/* pattern() is called in a timed loop: warn once, not on every frame */
+static int pattern_warned;
+
+static TEE_Result alloc_aes(void)
+{
+	const struct aes_backend *b;
+	size_t n;
+
+	for (n = 0; n < sizeof(aes_backends) / sizeof(aes_backends[0]); n++) {
+		b = aes_backends[n];
+#ifdef CFG_AES_BACKEND
+		if (strcmp(b->name, CFG_AES_BACKEND))
+			continue;
+#endif
+		if (!b->probe() || b->set_key(aes_key))
+			continue;
+		DMSG("AES backend: %s", b->name);
+		aes = b;
+		return TEE_SUCCESS;
+	}
+
+	EMSG("No usable AES backend");
+	return TEE_ERROR_NOT_SUPPORTED;
+}
+
+static TEE_Result alloc_mac_op(void)
+{
+	TEE_Result res;
+	TEE_ObjectHandle hkey;
+	TEE_Attribute attr;
+
+	res = TEE_AllocateOperation(&mac_op, TEE_ALG_HMAC_SHA256, TEE_MODE_MAC,
+				    sizeof(mac_key) * 8);
+	if (res != TEE_SUCCESS) {
+		mac_op = NULL;
+		return res;
+	}
+
+	res = TEE_AllocateTransientObject(TEE_TYPE_HMAC_SHA256,
+					  sizeof(mac_key) * 8, &hkey);
+	if (res != TEE_SUCCESS)
+		goto free_op;
+
+	attr.attributeID = TEE_ATTR_SECRET_VALUE;
+	attr.content.ref.buffer = (void *)mac_key;
+	attr.content.ref.length = sizeof(mac_key);
+
+	res = TEE_PopulateTransientObject(hkey, &attr, 1);
+	if (res == TEE_SUCCESS)
+		res = TEE_SetOperationKey(mac_op, hkey);
+	TEE_FreeTransientObject(hkey);
+	if (res == TEE_SUCCESS)
+		return TEE_SUCCESS;
+
+free_op:
+	EMSG("Cannot set up HMAC-SHA256: 0x%08x", res);
+	TEE_FreeOperation(mac_op);
+	mac_op = NULL;
+	return res;
+}
+
+static void free_session_resources(void)
+{
+	if (aes)
+		aes->release();
+	aes = NULL;
+	if (mac_op)
+		TEE_FreeOperation(mac_op);
+	mac_op = NULL;
+	pattern_warned = 0;
+	scaler_release();
+}
+
+/*
+ * Everything the frame path needs is allocated here, once for all sessions,
+ * so that commands never call the allocator and cannot fail on a fragmented
+ * heap in the middle of a stream.
+ */
+static TEE_Result alloc_session_resources(void)
+{
+	TEE_Result res;
+
+	res = alloc_aes();
+	if (res != TEE_SUCCESS)
+		free_session_resources();
+	return res;
+}
 
 /*
  * Called when the instance of the TA is created. This is the first call in
@@ -36,6 +153,7 @@ static TEE_OperationHandle crypto_op = NULL;
  */
 TEE_Result TA_CreateEntryPoint(void)
 {
+	mem_stats_init();
 	return TEE_SUCCESS;
 }
 
@@ -55,6 +173,8 @@ void TA_DestroyEntryPoint(void)
 TEE_Result TA_OpenSessionEntryPoint(uint32_t param_types,
 		TEE_Param  params[4], void **sess_ctx)
 {
+	TEE_Result res;
+	size_t heap;
 	uint32_t exp_param_types = TEE_PARAM_TYPES(TEE_PARAM_TYPE_NONE,
 						   TEE_PARAM_TYPE_NONE,
 						   TEE_PARAM_TYPE_NONE,
@@ -66,6 +186,18 @@ TEE_Result TA_OpenSessionEntryPoint(uint32_t param_types,
 	(void)&params;
 	(void)&sess_ctx;
 
+	if (!session_count) {
+		mem_stats_paint_stack();
+		res = alloc_session_resources();
+		if (res != TEE_SUCCESS)
+			return res;
+		/* Not in DMSG(), which may compile to nothing */
+		heap = mem_stats_sample_heap();
+		DMSG("Heap in use: %zd bytes", heap);
+		(void)heap;
+	}
+	session_count++;
+
 	/*
 	 * The DMSG() macro is non-standard, TEE Internal API doesn't
 	 * specify any means to logging from a TA.
@@ -83,16 +215,14 @@ void TA_CloseSessionEntryPoint(void *sess_ctx)
 {
 	(void)&sess_ctx; /* Unused parameter */
 
-	if (crypto_op)
-		TEE_FreeOperation(crypto_op);
+	if (!--session_count)
+		free_session_resources();
 	DMSG("Session closed");
 }
 
 static TEE_Result clear_screen(uint32_t param_types, TEE_Param params[4])
 {
 	TEE_Result res;
-	uint8_t *buf;
-	size_t size = 16 * 1024;
 	size_t out_sz, offset = 0;
 	uint32_t exp_param_types = TEE_PARAM_TYPES(TEE_PARAM_TYPE_VALUE_INPUT,
 						   TEE_PARAM_TYPE_NONE,
@@ -104,60 +234,108 @@ static TEE_Result clear_screen(uint32_t param_types, TEE_Param params[4])
 
 	DMSG("Clear screen request, color: 0x%08x", params[0].value.a);
 
-	buf = TEE_Malloc(size, 0);
-	if (!buf)
-		return TEE_ERROR_OUT_OF_MEMORY;
-	memset(buf, params[0].value.a, size);
+	memset(clear_buf, params[0].value.a, sizeof(clear_buf));
 
 	do {
-		res = TEEExt_UpdateFrameBuffer(buf, size, offset, &out_sz);
+		res = TEEExt_UpdateFrameBuffer(clear_buf, sizeof(clear_buf),
+					       offset, &out_sz);
 		offset += out_sz;
 	} while (res == TEE_SUCCESS && out_sz != 0);
 
-	TEE_Free(buf);
 	return TEE_SUCCESS;
 }
 
-/* Decrypt chunk of data */
-static TEE_Result decrypt(void *in, size_t sz, void *out, size_t *outsz)
+/*
+ * Decrypt chunk of data. iv is NULL for AES-ECB, or the AES-CTR counter block
+ * for the first byte of in, in which case it is advanced past the decrypted
+ * data.
+ */
+static TEE_Result decrypt(void *in, size_t sz, void *out, size_t *outsz,
+			  uint8_t *iv)
 {
-	TEE_Result res;
-	TEE_ObjectHandle hkey;
-	TEE_Attribute attr;
+	int rc;
 
-	if (!crypto_op) {
-		DMSG("TEE_AllocateOperation");
-		res = TEE_AllocateOperation(&crypto_op, TEE_ALG_AES_ECB_NOPAD,
-					    TEE_MODE_DECRYPT, 128);
-		CHECK(res, "TEE_AllocateOperation", return res;);
+	*outsz = MIN(sz, *outsz);
+	if (iv)
+		rc = aes->ctr_crypt(iv, in, out, *outsz);
+	else if (*outsz % AES_BLOCK_SIZE)
+		return TEE_ERROR_BAD_PARAMETERS;
+	else
+		rc = aes->ecb_decrypt(in, out, *outsz);
 
-		DMSG("TEE_AllocateTransientObject");
-		res = TEE_AllocateTransientObject(TEE_TYPE_AES, 128, &hkey);
-		CHECK(res, "TEE_AllocateTransientObject", return res;);
+	if (rc) {
+		EMSG("%s: %s backend failed", __func__, aes->name);
+		return TEE_ERROR_GENERIC;
+	}
+	return TEE_SUCCESS;
+}
 
-		attr.attributeID = TEE_ATTR_SECRET_VALUE;
-		attr.content.ref.buffer = aes_key;
-		attr.content.ref.length = sizeof(aes_key);
+static TEE_Result set_scaler(uint32_t param_types, TEE_Param params[4])
+{
+	uint32_t exp_param_types = TEE_PARAM_TYPES(TEE_PARAM_TYPE_VALUE_INPUT,
+						   TEE_PARAM_TYPE_VALUE_INPUT,
+						   TEE_PARAM_TYPE_NONE,
+						   TEE_PARAM_TYPE_NONE);
+
+	if (param_types != exp_param_types)
+		return TEE_ERROR_BAD_PARAMETERS;
 
-		DMSG("TEE_PopulateTransientObject");
-		res = TEE_PopulateTransientObject(hkey, &attr, 1);
-		CHECK(res, "TEE_PopulateTransientObject", return res;);
+	DMSG("Scaler: %ux%u to %ux%u at (%u,%u), filter %u",
+	     params[0].value.a & 0xffff, params[0].value.a >> 16,
+	     params[1].value.b & 0xffff, params[1].value.b >> 16,
+	     params[1].value.a & 0xffff, params[1].value.a >> 16,
+	     params[0].value.b);
+
+	return scaler_setup(params[0].value.a & 0xffff,
+			    params[0].value.a >> 16, params[0].value.b,
+			    params[1].value.a & 0xffff,
+			    params[1].value.a >> 16,
+			    params[1].value.b & 0xffff,
+			    params[1].value.b >> 16);
+}
 
-		DMSG("TEE_SetOperationKey");
-		res = TEE_SetOperationKey(crypto_op, hkey);
-		CHECK(res, "TEE_SetOperationKey", return res;);
+/* Feed source image data to the scaler, which writes to the framebuffer */
+static TEE_Result scale_image_data(void *buf, size_t sz, size_t offset,
+				   uint32_t flags, uint8_t *iv, void *outbuf,
+				   size_t outsz)
+{
+	TEE_Result res;
+	size_t dsz;
 
-		TEE_FreeTransientObject(hkey);
-	}
+	if (flags & IMAGE_START)
+		scaler_start();
+	if (offset != scaler_consumed())
+		return TEE_ERROR_BAD_PARAMETERS;
 
-	DMSG("TEE_CipherInit");
-	TEE_CipherInit(crypto_op, NULL, 0);
+	DMSG("Scaled image data: %zd bytes at source offset %u (flags: 0x%04x)",
+	     sz, offset, flags);
 
-	DMSG("TEE_CipherDoFinal");
-	*outsz = MIN(sz, *outsz);
-	res = TEE_CipherDoFinal(crypto_op, in, *outsz, out, outsz);
-	CHECK(res, "TEE_CipherDoFinal", return res;);
+	if (flags & IMAGE_ENCRYPTED) {
+		res = TEE_CheckMemoryAccessRights(TEE_MEMORY_ACCESS_WRITE,
+						  outbuf, outsz);
+		if (res != TEE_SUCCESS)
+			EMSG("%s: WARNING: output buffer is not secure", __func__);
+
+		while (sz > 0) {
+			dsz = sizeof(scale_buf);
+			res = decrypt(buf, sz, scale_buf, &dsz, iv);
+			if (res != TEE_SUCCESS)
+				return res;
+			res = scaler_push(scale_buf, dsz, outbuf, outsz);
+			if (res != TEE_SUCCESS)
+				return res;
+			sz -= dsz;
+			buf = (uint8_t *)buf + dsz;
+		}
+	} else {
+		/* Like unscaled plaintext, through TEEExt_UpdateFrameBuffer() */
+		res = scaler_push(buf, sz, NULL, 0);
+		if (res != TEE_SUCCESS)
+			return res;
+	}
 
+	if ((flags & IMAGE_END) && !scaler_done())
+		DMSG("Scaled image is incomplete");
 	return TEE_SUCCESS;
 }
 
@@ -167,12 +345,20 @@ static TEE_Result image_data(uint32_t param_types, TEE_Param params[4])
 	void *buf, *outbuf;
 	size_t sz, outsz, offset, dsz;
 	uint32_t flags;
+	uint8_t ctr[16];
+	uint8_t *iv = NULL;
 	uint32_t exp_param_types = TEE_PARAM_TYPES(TEE_PARAM_TYPE_MEMREF_INPUT,
 						   TEE_PARAM_TYPE_VALUE_INPUT,
 						   TEE_PARAM_TYPE_MEMREF_OUTPUT,
 						   TEE_PARAM_TYPE_NONE);
-
-	if (param_types != exp_param_types)
+	uint32_t exp_ctr_param_types =
+			TEE_PARAM_TYPES(TEE_PARAM_TYPE_MEMREF_INPUT,
+					TEE_PARAM_TYPE_VALUE_INPUT,
+					TEE_PARAM_TYPE_MEMREF_OUTPUT,
+					TEE_PARAM_TYPE_MEMREF_INPUT);
+
+	if (param_types != exp_param_types &&
+	    param_types != exp_ctr_param_types)
 		return TEE_ERROR_BAD_PARAMETERS;
 
 	buf = params[0].memref.buffer;
@@ -182,6 +368,20 @@ static TEE_Result image_data(uint32_t param_types, TEE_Param params[4])
 	outbuf = params[2].memref.buffer;
 	outsz = params[2].memref.size;
 
+	if (flags & IMAGE_CTR) {
+		if (param_types != exp_ctr_param_types ||
+		    !(flags & IMAGE_ENCRYPTED) ||
+		    params[3].memref.size != sizeof(ctr))
+			return TEE_ERROR_BAD_PARAMETERS;
+		/* Private copy, normal world may still modify the original */
+		memcpy(ctr, params[3].memref.buffer, sizeof(ctr));
+		iv = ctr;
+	}
+
+	if (flags & IMAGE_SCALE)
+		return scale_image_data(buf, sz, offset, flags, iv, outbuf,
+					outsz);
+
 	if (offset + sz > outsz)
 		return TEE_ERROR_SHORT_BUFFER;
 
@@ -200,8 +400,9 @@ static TEE_Result image_data(uint32_t param_types, TEE_Param params[4])
 			EMSG("%s: WARNING: output buffer is not secure", __func__);
 
 		while (sz > 0) {
+			dsz = sz;
 			res = decrypt(buf, sz, (uint8_t *)outbuf + offset,
-				      &dsz);
+				      &dsz, iv);
 			if (res != TEE_SUCCESS)
 				return res;
 			sz -= dsz;
@@ -214,6 +415,114 @@ static TEE_Result image_data(uint32_t param_types, TEE_Param params[4])
 	}
 }
 
+static TEE_Result pattern(uint32_t param_types, TEE_Param params[4])
+{
+	TEE_Result res;
+	uint32_t exp_param_types = TEE_PARAM_TYPES(TEE_PARAM_TYPE_VALUE_INPUT,
+						   TEE_PARAM_TYPE_MEMREF_OUTPUT,
+						   TEE_PARAM_TYPE_NONE,
+						   TEE_PARAM_TYPE_NONE);
+
+	if (param_types != exp_param_types)
+		return TEE_ERROR_BAD_PARAMETERS;
+
+	/*
+	 * Checked on every invoke: another buffer may be mapped at the same
+	 * address. It is cheap next to filling the frame.
+	 */
+	res = TEE_CheckMemoryAccessRights(TEE_MEMORY_ACCESS_WRITE,
+					  params[1].memref.buffer,
+					  params[1].memref.size);
+	if (res != TEE_SUCCESS && !pattern_warned) {
+		EMSG("%s: WARNING: output buffer is not secure", __func__);
+		pattern_warned = 1;
+	}
+
+	return pattern_draw(params[0].value.a, params[0].value.b,
+			    params[1].memref.buffer, params[1].memref.size);
+}
+
+/*
+ * Only the digest leaves the secure world, so that output can be checked
+ * without exposing the plaintext. The digest is keyed, so it cannot be
+ * computed for guessed contents outside the TA, and rectangles are whole
+ * tiles (cut only by the edges of the framebuffer), so that no single pixel
+ * can be singled out.
+ */
+static TEE_Result checksum_rect(uint32_t param_types, TEE_Param params[4])
+{
+	uint32_t x = params[0].value.a & 0xffff;
+	uint32_t y = params[0].value.a >> 16;
+	uint32_t w = params[0].value.b & 0xffff;
+	uint32_t h = params[0].value.b >> 16;
+	const uint32_t geom[2] = { params[0].value.a, params[0].value.b };
+	const size_t row_sz = FB_WIDTH * FB_BPP;
+	const uint8_t *fb;
+	size_t mac_sz = CHECKSUM_SIZE;
+	uint32_t j;
+	TEE_Result res;
+	/* The framebuffer is registered as output memory by the host */
+	uint32_t exp_param_types = TEE_PARAM_TYPES(TEE_PARAM_TYPE_VALUE_INPUT,
+						   TEE_PARAM_TYPE_MEMREF_OUTPUT,
+						   TEE_PARAM_TYPE_MEMREF_OUTPUT,
+						   TEE_PARAM_TYPE_NONE);
+
+	if (param_types != exp_param_types)
+		return TEE_ERROR_BAD_PARAMETERS;
+	if (!w || !h || x + w > FB_WIDTH || y + h > FB_HEIGHT ||
+	    (x | y) % CHECKSUM_TILE ||
+	    (w % CHECKSUM_TILE && x + w != FB_WIDTH) ||
+	    (h % CHECKSUM_TILE && y + h != FB_HEIGHT))
+		return TEE_ERROR_BAD_PARAMETERS;
+	if (params[1].memref.size < row_sz * FB_HEIGHT ||
+	    params[2].memref.size < CHECKSUM_SIZE)
+		return TEE_ERROR_SHORT_BUFFER;
+	/* On first use only, so that playback works without HMAC-SHA256 */
+	if (!mac_op && alloc_mac_op() != TEE_SUCCESS)
+		return TEE_ERROR_NOT_SUPPORTED;
+
+	TEE_MACInit(mac_op, NULL, 0);
+	/* Same pixels in another rectangle give another digest */
+	TEE_MACUpdate(mac_op, geom, sizeof(geom));
+	fb = (const uint8_t *)params[1].memref.buffer + y * row_sz +
+	     x * FB_BPP;
+	if (w == FB_WIDTH) {
+		/* Contiguous rows */
+		TEE_MACUpdate(mac_op, fb, h * row_sz);
+	} else {
+		for (j = 0; j < h; j++)
+			TEE_MACUpdate(mac_op, fb + j * row_sz, w * FB_BPP);
+	}
+	res = TEE_MACComputeFinal(mac_op, NULL, 0, params[2].memref.buffer,
+				  &mac_sz);
+	if (res != TEE_SUCCESS)
+		return res;
+	params[2].memref.size = mac_sz;
+
+	DMSG("Digest of %ux%u at (%u,%u)", w, h, x, y);
+	return TEE_SUCCESS;
+}
+
+static TEE_Result get_mem_stats(uint32_t param_types, TEE_Param params[4])
+{
+	const struct arena *a = scaler_arena();
+	uint32_t exp_param_types = TEE_PARAM_TYPES(TEE_PARAM_TYPE_VALUE_OUTPUT,
+						   TEE_PARAM_TYPE_VALUE_OUTPUT,
+						   TEE_PARAM_TYPE_VALUE_OUTPUT,
+						   TEE_PARAM_TYPE_NONE);
+
+	if (param_types != exp_param_types)
+		return TEE_ERROR_BAD_PARAMETERS;
+
+	params[0].value.a = mem_stats_sample_heap();
+	params[0].value.b = mem_stats_heap_max_sampled();
+	params[1].value.a = mem_stats_stack_peak();
+	params[1].value.b = mem_stats_stack_window();
+	params[2].value.a = a->peak;
+	params[2].value.b = a->size;
+	return TEE_SUCCESS;
+}
+
 /*
  * Called when a TA is invoked. sess_ctx hold that value that was
  * assigned by TA_OpenSessionEntryPoint(). The rest of the paramters
@@ -229,6 +538,14 @@ TEE_Result TA_InvokeCommandEntryPoint(void *sess_ctx, uint32_t cmd_id,
 		return clear_screen(param_types, params);
 	case TA_SECVIDEO_DEMO_IMAGE_DATA:
 		return image_data(param_types, params);
+	case TA_SECVIDEO_DEMO_SET_SCALER:
+		return set_scaler(param_types, params);
+	case TA_SECVIDEO_DEMO_GET_MEM_STATS:
+		return get_mem_stats(param_types, params);
+	case TA_SECVIDEO_DEMO_PATTERN:
+		return pattern(param_types, params);
+	case TA_SECVIDEO_DEMO_CHECKSUM_RECT:
+		return checksum_rect(param_types, params);
 	default:
 		return TEE_ERROR_BAD_PARAMETERS;
 	}
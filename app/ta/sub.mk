@@ -1 +1,21 @@
 srcs-y += secvideo_demo_ta.c
+srcs-y += scaler.c
+srcs-y += arena.c
+srcs-y += mem_stats.c
+srcs-y += pattern.c
+srcs-y += aes_ce.c
+srcs-y += aes_soft.c
+srcs-y += aes_tee.c
+
+# AES backend: ce, tee or soft, or auto for the first usable one in that
+# order. ce is only built in with CFG_AES_CE=y, for a 32-bit TA running on
+# an ARMv8 core with the Crypto Extensions (the TEE core must then also let
+# TAs use NEON).
+CFG_AES_BACKEND ?= auto
+ifneq ($(CFG_AES_BACKEND),auto)
+cppflags-y += -DCFG_AES_BACKEND=\"$(CFG_AES_BACKEND)\"
+endif
+ifeq ($(CFG_AES_CE),y)
+cflags-aes_ce.c-y += -march=armv8-a -mfpu=crypto-neon-fp-armv8
+cflags-aes_ce.c-y += -mfloat-abi=softfp
+endif
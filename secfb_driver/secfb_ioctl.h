@@ -2,12 +2,45 @@
 #define _SECFB_IOCTL_H_
 
 #include <linux/ioctl.h>
+#include <linux/types.h>
+
+/* secfb_io.flags: how the buffer is mapped by mmap() on the returned fd */
+#define SECFB_MAP_WC            0       /* Write-combined, for CPU producers */
+#define SECFB_MAP_CACHED        1       /* Cached, needs SECFB_IOCTL_SYNC */
+/*
+ * SECFB_MAP_CACHED fails with EOPNOTSUPP when the buffer is outside of the
+ * kernel linear mapping (e.g. a carve-out), whose caches cannot be synced
+ */
 
 struct secfb_io {
         int fd;
         size_t size;
+        unsigned int flags;
+};
+
+/*
+ * Cache maintenance around CPU access to part of the buffer, like
+ * DMA_BUF_IOCTL_SYNC (which this kernel does not have) but on the secfb
+ * device, for the mapping of the fd returned by SECFB_IOCTL_GET_SECFB_FD.
+ * The flags have the same values as in struct dma_buf_sync.
+ */
+#define SECFB_SYNC_READ         (1 << 0)
+#define SECFB_SYNC_WRITE        (2 << 0)
+#define SECFB_SYNC_RW           (SECFB_SYNC_READ | SECFB_SYNC_WRITE)
+#define SECFB_SYNC_START        (0 << 2)
+#define SECFB_SYNC_END          (1 << 2)
+#define SECFB_SYNC_VALID_FLAGS_MASK \
+        (SECFB_SYNC_RW | SECFB_SYNC_END)
+
+struct secfb_sync {
+        __u64 flags;
+        __u64 offset;
+        __u64 len;      /* 0: up to the end of the buffer */
+        __s32 fd;       /* secfb_io.fd */
+        __u32 pad;
 };
 
 #define SECFB_IOCTL_GET_SECFB_FD        _IOW('r', 1, struct secfb_io)
+#define SECFB_IOCTL_SYNC                _IOW('r', 2, struct secfb_sync)
 
 #endif /* _SECFB_IOCTL_H_ */
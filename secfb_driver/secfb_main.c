@@ -6,6 +6,8 @@
 #include <linux/device.h>
 #include <linux/fs.h>
 #include <linux/dma-buf.h>
+#include <linux/dma-mapping.h>
+#include <linux/mm.h>
 #include <asm/uaccess.h>
 #include <linux/slab.h>
 #include "secfb_ioctl.h"
@@ -24,8 +26,25 @@ static struct secfb_buffer {
 	.paddr = 0xff000000,	/* FRAMEBUFFER_BASE in OP-TEE OS */
 	.size = 0x00200000,	/* FRAMEBUFFER_SIZE in OP-TEE OS */
 };
+
+/* dma-buf private data: each fd keeps the mapping it was exported with */
+struct secfb_export {
+	struct secfb_buffer *buff;
+	unsigned int flags;	/* SECFB_MAP_* */
+};
 static struct miscdevice secfb_dev;
 
+/*
+ * dma_sync_single_*() work on the linear mapping, which the carve-out
+ * usually is not part of. Without it, there is no way to maintain the
+ * caches of a cached user mapping, so only write-combined is offered.
+ */
+static bool secfb_can_cache(struct secfb_buffer *buff)
+{
+	return pfn_valid(__phys_to_pfn(buff->paddr)) &&
+	       pfn_valid(__phys_to_pfn(buff->paddr + buff->size - 1));
+}
+
 /*
  * dma-buf operations
  */
@@ -34,7 +53,8 @@ static struct sg_table *secfb_dmabuf_map_dma_buf(struct dma_buf_attachment
 							*attach,
 						 enum dma_data_direction dir)
 {
-	struct secfb_buffer *buff = attach->dmabuf->priv;
+	struct secfb_export *exp = attach->dmabuf->priv;
+	struct secfb_buffer *buff = exp->buff;
 	struct sg_table *sgt;
 
 	sgt = kmalloc(sizeof(*sgt), GFP_KERNEL);
@@ -62,34 +82,97 @@ static void secfb_dmabuf_unmap_dma_buf(struct dma_buf_attachment *attach,
 
 static void secfb_dmabuf_release(struct dma_buf *dmabuf)
 {
+	kfree(dmabuf->priv);
 }
 
-static void *secfb_dmabuf_kmap_atomic(struct dma_buf *dmabuf,
-				      unsigned long pgnum)
+/*
+ * Make [start, start + len) of the buffer coherent for the CPU (begin) or
+ * for the display (end). The buffer is not behind an IOMMU, so its DMA
+ * address is its physical address. A write-combined mapping is not cached,
+ * it only needs its write buffers drained at the end.
+ */
+static int secfb_cpu_access(struct secfb_export *exp, size_t start,
+			    size_t len, enum dma_data_direction dir, bool end)
 {
-	/* Buffer cannot be mapped to kernel space */
-	return NULL;
+	struct device *dev = secfb_dev.this_device;
+	struct secfb_buffer *buff = exp->buff;
+
+	if (start > buff->size || len > buff->size - start)
+		return -EINVAL;
+	if (!len)
+		return 0;
+
+	if (!(exp->flags & SECFB_MAP_CACHED) || !secfb_can_cache(buff)) {
+		if (end)
+			wmb();
+		return 0;
+	}
+
+	if (end)
+		dma_sync_single_for_device(dev, buff->paddr + start, len, dir);
+	else
+		dma_sync_single_for_cpu(dev, buff->paddr + start, len, dir);
+	return 0;
+}
+
+static int secfb_dmabuf_begin_cpu_access(struct dma_buf *dmabuf,
+					 size_t start, size_t len,
+					 enum dma_data_direction dir)
+{
+	return secfb_cpu_access(dmabuf->priv, start, len, dir, false);
+}
+
+static void secfb_dmabuf_end_cpu_access(struct dma_buf *dmabuf,
+					size_t start, size_t len,
+					enum dma_data_direction dir)
+{
+	secfb_cpu_access(dmabuf->priv, start, len, dir, true);
 }
 
+/*
+ * Through the linear mapping, when the buffer has one. While the buffer is
+ * secure, reads return zeroes and writes are ignored, as for user space.
+ */
 static void *secfb_dmabuf_kmap(struct dma_buf *dmabuf, unsigned long pgnum)
 {
-	/* Buffer cannot be mapped to kernel space */
-	return NULL;
+	struct secfb_export *exp = dmabuf->priv;
+	struct secfb_buffer *buff = exp->buff;
+	phys_addr_t pa = buff->paddr + ((phys_addr_t)pgnum << PAGE_SHIFT);
+
+	if (pgnum >= buff->size >> PAGE_SHIFT || !pfn_valid(__phys_to_pfn(pa)))
+		return NULL;
+	return page_address(phys_to_page(pa));
+}
+
+static void *secfb_dmabuf_kmap_atomic(struct dma_buf *dmabuf,
+				      unsigned long pgnum)
+{
+	return secfb_dmabuf_kmap(dmabuf, pgnum);
 }
 
 static int secfb_dmabuf_mmap(struct dma_buf *dmabuf,
 			     struct vm_area_struct *vma)
 {
-	struct secfb_buffer *buff = dmabuf->priv;
+	struct secfb_export *exp = dmabuf->priv;
+	struct secfb_buffer *buff;
 	size_t size = vma->vm_end - vma->vm_start;
 	int ret;
 
 	pgprot_t prot;
 
-	if (WARN_ON(!buff))
+	if (WARN_ON(!exp))
 		return -EINVAL;
-
-	prot = vma->vm_page_prot;
+	buff = exp->buff;
+
+	/*
+	 * Cached for CPU readback (with SECFB_IOCTL_SYNC around accesses),
+	 * write-combined otherwise: coherent with the display, and writes
+	 * are merged instead of going out one at a time.
+	 */
+	if (exp->flags & SECFB_MAP_CACHED)
+		prot = vma->vm_page_prot;
+	else
+		prot = pgprot_writecombine(vma->vm_page_prot);
 
 	ret =
 	    remap_pfn_range(vma, vma->vm_start, buff->paddr >> PAGE_SHIFT, size,
@@ -97,8 +180,9 @@ static int secfb_dmabuf_mmap(struct dma_buf *dmabuf,
 	if (!ret)
 		vma->vm_private_data = (void *)buff;
 
-	dev_dbg(secfb_dev.this_device, "mmap (p@=0x%08x,s=%dKiB) => %x [ret=%d]\n",
+	dev_dbg(secfb_dev.this_device, "mmap (p@=0x%08x,s=%dKiB,%s) => %x [ret=%d]\n",
 		buff->paddr, (int)size / 1024,
+		exp->flags & SECFB_MAP_CACHED ? "cached" : "wc",
 		(unsigned int)vma->vm_start, ret);
 
 	return ret;
@@ -108,6 +192,8 @@ static struct dma_buf_ops dma_buf_ops = {
 	.map_dma_buf = secfb_dmabuf_map_dma_buf,
 	.unmap_dma_buf = secfb_dmabuf_unmap_dma_buf,
 	.release = secfb_dmabuf_release,
+	.begin_cpu_access = secfb_dmabuf_begin_cpu_access,
+	.end_cpu_access = secfb_dmabuf_end_cpu_access,
 	.kmap_atomic = secfb_dmabuf_kmap_atomic,
 	.kmap = secfb_dmabuf_kmap,
 	.mmap = secfb_dmabuf_mmap,
@@ -135,20 +221,90 @@ static int secfb_release(struct inode *inode, struct file *file)
 
 static int get_secfb_fd(struct secfb_io __user *u_secfb)
 {
-	int ret;
 	struct secfb_io k_secfb;
+	struct secfb_export *exp;
 	struct dma_buf *secfb_dmabuf;
+	int fd;
+
+	if (copy_from_user(&k_secfb, u_secfb, sizeof(k_secfb)))
+		return -EFAULT;
+	if (k_secfb.flags & ~SECFB_MAP_CACHED)
+		return -EINVAL;
+	if ((k_secfb.flags & SECFB_MAP_CACHED) && !secfb_can_cache(&buffer))
+		return -EOPNOTSUPP;
+
+	exp = kmalloc(sizeof(*exp), GFP_KERNEL);
+	if (!exp)
+		return -ENOMEM;
+	exp->buff = &buffer;
+	exp->flags = k_secfb.flags;
 
-	secfb_dmabuf = dma_buf_export(&buffer, &dma_buf_ops,
+	secfb_dmabuf = dma_buf_export(exp, &dma_buf_ops,
 				      buffer.size, O_RDWR, NULL);
-	if (!secfb_dmabuf)
+	if (IS_ERR_OR_NULL(secfb_dmabuf)) {
+		kfree(exp);
 		return -ENOMEM;
+	}
+	fd = dma_buf_fd(secfb_dmabuf, 0);
+	if (fd < 0) {
+		/* Frees exp */
+		dma_buf_put(secfb_dmabuf);
+		return fd;
+	}
 
 	memset(&k_secfb, 0, sizeof(k_secfb));
-	k_secfb.fd = dma_buf_fd(secfb_dmabuf, 0);
+	k_secfb.fd = fd;
 	k_secfb.size = buffer.size;
-	ret = copy_to_user(u_secfb, &k_secfb, sizeof(*u_secfb));
+	k_secfb.flags = exp->flags;
+	if (copy_to_user(u_secfb, &k_secfb, sizeof(*u_secfb)))
+		return -EFAULT;
+
+	return 0;
+}
 
+static int secfb_sync(struct secfb_sync __user *u_sync)
+{
+	struct secfb_sync k_sync;
+	enum dma_data_direction dir;
+	struct dma_buf *dmabuf;
+	u64 len;
+	int ret;
+
+	if (copy_from_user(&k_sync, u_sync, sizeof(k_sync)))
+		return -EFAULT;
+	if (k_sync.flags & ~SECFB_SYNC_VALID_FLAGS_MASK)
+		return -EINVAL;
+
+	switch (k_sync.flags & SECFB_SYNC_RW) {
+	case SECFB_SYNC_READ:
+		dir = DMA_FROM_DEVICE;
+		break;
+	case SECFB_SYNC_WRITE:
+		dir = DMA_TO_DEVICE;
+		break;
+	case SECFB_SYNC_RW:
+		dir = DMA_BIDIRECTIONAL;
+		break;
+	default:
+		return -EINVAL;
+	}
+
+	if (k_sync.offset > buffer.size)
+		return -EINVAL;
+	len = k_sync.len ? k_sync.len : buffer.size - k_sync.offset;
+	if (len > buffer.size - k_sync.offset)
+		return -EINVAL;
+
+	/* The mapping to sync is the one of this fd */
+	dmabuf = dma_buf_get(k_sync.fd);
+	if (IS_ERR(dmabuf))
+		return PTR_ERR(dmabuf);
+	if (dmabuf->ops == &dma_buf_ops)
+		ret = secfb_cpu_access(dmabuf->priv, k_sync.offset, len, dir,
+				       k_sync.flags & SECFB_SYNC_END);
+	else
+		ret = -EINVAL;
+	dma_buf_put(dmabuf);
 	return ret;
 }
 
@@ -160,6 +316,9 @@ static long secfb_ioctl(struct file *file, unsigned int cmd, unsigned long arg)
 	case SECFB_IOCTL_GET_SECFB_FD:
 		ret = get_secfb_fd((struct secfb_io __user *)arg);
 		break;
+	case SECFB_IOCTL_SYNC:
+		ret = secfb_sync((struct secfb_sync __user *)arg);
+		break;
 	default:
 		ret = -ENOSYS;
 	}
@@ -190,6 +349,11 @@ static int __init secfb_init(void)
 	if (ret)
 		return ret;
 
+	/* The device is only used for cache maintenance of the buffer */
+	secfb_dev.this_device->coherent_dma_mask = DMA_BIT_MASK(32);
+	secfb_dev.this_device->dma_mask =
+		&secfb_dev.this_device->coherent_dma_mask;
+
 	printk(KERN_INFO "secfb: initialized (minor=%d)\n", secfb_dev.minor);
 	return 0;
 }